@@ -0,0 +1,204 @@
+/*
+  Micro-benchmark host for mod-advanced-control-to-cv
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+  THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+   Loads the plugin binary with dlopen(), instantiates it with a fake
+   urid:map and a fake HMI widget control, and times run() for a range of
+   block sizes, smoothing modes, round settings and knob automation patterns.
+
+   Cases are run with and without the worker feature.  The fake worker runs
+   scheduled work synchronously after run(), like a host without a worker
+   thread would, and its time is reported separately from run().
+
+   Usage: bench PLUGIN.so [SAMPLES_PER_CASE]
+
+   Results are printed to stdout as CSV, one line per case:
+   block_size,smoothing,round,worker,pattern,blocks,ns_per_block,ns_per_sample,
+   work_ns_per_block,hmi_calls
+   The reported numbers are the median of several repetitions.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fake_host.h"
+
+#define MAX_BLOCK_SIZE  2048
+#define OUT_CAPACITY    8192
+#define REPETITIONS     7
+#define SAMPLE_RATE     48000.0
+#define SMOOTH_MODES    5
+
+typedef enum {
+    PATTERN_STATIC = 0,
+    PATTERN_RAMP,
+    PATTERN_RANDOM,
+    PATTERN_COUNT
+} Pattern;
+
+static const char* const pattern_names[PATTERN_COUNT] = {
+    "static",
+    "ramp",
+    "random",
+};
+
+static double
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int
+cmp_double(const void* a, const void* b)
+{
+    const double da = *(const double*)a;
+    const double db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+static void
+fill_pattern(float* knob, uint32_t n_blocks, Pattern pattern)
+{
+    for (uint32_t i = 0; i < n_blocks; i++) {
+        switch (pattern) {
+            case PATTERN_STATIC:
+                knob[i] = 5.0f;
+                break;
+            case PATTERN_RAMP:
+                // triangle sweep over the full knob range
+                knob[i] = (i % 2000) < 1000 ? (i % 1000) * 0.01f
+                                            : 10.0f - (i % 1000) * 0.01f;
+                break;
+            case PATTERN_RANDOM:
+                knob[i] = (rand() % 10001) * 0.001f;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s PLUGIN.so [SAMPLES_PER_CASE]\n", argv[0]);
+        return 1;
+    }
+
+    const uint32_t samples_per_case = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10)
+                                               : 1 << 20;
+
+    FakeHost host;
+    if (!load_plugin(&host, argv[1]))
+        return 1;
+
+    const LV2_Descriptor* desc = host.desc;
+
+    static float controls[N_PORTS];
+    static float output[MAX_BLOCK_SIZE];
+    static uint64_t out_buf[OUT_CAPACITY / sizeof(uint64_t)];
+
+    LV2_Atom_Sequence in_seq;
+    empty_sequence(&in_seq);
+
+    LV2_Atom_Sequence* out_seq = (LV2_Atom_Sequence*)out_buf;
+
+    const uint32_t max_blocks = samples_per_case / 16;
+    float* knob_values = (float*)malloc(sizeof(float) * max_blocks);
+
+    printf("block_size,smoothing,round,worker,pattern,blocks,ns_per_block,ns_per_sample,"
+           "work_ns_per_block,hmi_calls\n");
+
+    for (uint32_t block_size = 16; block_size <= MAX_BLOCK_SIZE; block_size *= 2) {
+        for (int smooth = 0; smooth < SMOOTH_MODES; smooth++) {
+            for (int round = 0; round <= 1; round++) {
+                for (int use_worker = 0; use_worker <= (host.worker ? 1 : 0); use_worker++) {
+                    for (int pattern = 0; pattern < PATTERN_COUNT; pattern++) {
+                        LV2_Handle instance = desc->instantiate(
+                            desc, SAMPLE_RATE, "",
+                            host_features(&host, use_worker ? HOST_HMI | HOST_WORKER : HOST_HMI));
+                        if (!instance) {
+                            fprintf(stderr, "bench: instantiate failed\n");
+                            return 1;
+                        }
+
+                        connect_all(desc, instance, controls, output, &in_seq, out_seq);
+                        controls[Smoothing] = smooth;
+                        controls[ROUND]     = round;
+
+                        if (desc->activate)
+                            desc->activate(instance);
+
+                        address_knob(&host, instance);
+
+                        const uint32_t n_blocks = samples_per_case / block_size;
+                        fill_pattern(knob_values, n_blocks, (Pattern)pattern);
+
+                        double results[REPETITIONS];
+                        double work_results[REPETITIONS];
+                        hmi_calls = 0;
+                        for (int r = 0; r < REPETITIONS; r++) {
+                            double work_ns = 0.0;
+                            const double start = now_ns();
+                            for (uint32_t b = 0; b < n_blocks; b++) {
+                                controls[Knob] = knob_values[b];
+                                reset_output(out_seq, OUT_CAPACITY);
+                                desc->run(instance, block_size);
+
+                                if (work_requested) {
+                                    const double work_start = now_ns();
+                                    run_work(&host, instance);
+                                    work_ns += now_ns() - work_start;
+                                }
+                            }
+                            results[r] = (now_ns() - start - work_ns) / n_blocks;
+                            work_results[r] = work_ns / n_blocks;
+                        }
+
+                        qsort(results, REPETITIONS, sizeof(double), cmp_double);
+                        qsort(work_results, REPETITIONS, sizeof(double), cmp_double);
+                        const double ns_per_block = results[REPETITIONS / 2];
+
+                        printf("%u,%d,%d,%d,%s,%u,%.1f,%.3f,%.1f,%lu\n",
+                               block_size, smooth, round, use_worker, pattern_names[pattern], n_blocks,
+                               ns_per_block, ns_per_block / block_size, work_results[REPETITIONS / 2],
+                               hmi_calls / REPETITIONS);
+                        fflush(stdout);
+
+                        if (host.notif)
+                            host.notif->unaddressed(instance, Knob);
+                        if (desc->deactivate)
+                            desc->deactivate(instance);
+                        desc->cleanup(instance);
+                    }
+                }
+            }
+        }
+    }
+
+    free(knob_values);
+    unload_plugin(&host);
+
+    return 0;
+}
@@ -0,0 +1,180 @@
+/*
+  Transfer curve benchmark for mod-advanced-control-to-cv
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+  THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+   Times curve_render() against a search for the segment of every sample in
+   the breakpoints, for curves of a few and of the most breakpoints.  The
+   curves follow an exponential, the levels sweep the knob range smoothly,
+   like a smoothed knob, or jump at random.
+
+   Results are printed to stdout as CSV, one line per case:
+   points,levels,search_ns_per_sample,table_ns_per_sample,speedup,max_diff
+   max_diff is the largest difference between both outputs, in knob units.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "curve.h"
+
+#define RANGE           10.0f
+#define BLOCK_SIZE      128
+#define N_BLOCKS        4096
+#define REPETITIONS     5
+
+/** Breakpoints on 2^(6 x) scaled to 0..1, sorted by x. */
+static void
+exponential_points(float* points, uint32_t n_points)
+{
+    for (uint32_t i = 0; i < n_points; i++) {
+        const float x = (float)i / (float)(n_points - 1);
+
+        points[2 * i]     = x;
+        points[2 * i + 1] = (exp2f(6.0f * x) - 1.0f) / 63.0f;
+    }
+}
+
+/** The lines between sorted breakpoints, a linear search per sample. */
+static void
+search_render(const float* points, uint32_t n_points, float* level, uint32_t n_samples)
+{
+    for (uint32_t i = 0; i < n_samples; i++) {
+        const float x = level[i] / RANGE;
+        float       y;
+
+        if (x <= points[0])
+            y = points[1];
+        else if (x >= points[2 * (n_points - 1)])
+            y = points[2 * (n_points - 1) + 1];
+        else {
+            uint32_t s = 0;
+            while (points[2 * (s + 1)] < x)
+                s++;
+
+            const float t = (x - points[2 * s]) / (points[2 * (s + 1)] - points[2 * s]);
+            y = points[2 * s + 1] + (points[2 * (s + 1) + 1] - points[2 * s + 1]) * t;
+        }
+
+        level[i] = y * RANGE;
+    }
+}
+
+static double
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int
+cmp_double(const void* a, const void* b)
+{
+    const double da = *(const double*)a;
+    const double db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+int
+main(int argc, char** argv)
+{
+    static const uint32_t point_counts[] = { 4, CURVE_MAX_POINTS };
+
+    float* sweep  = (float*)malloc(sizeof(float) * N_BLOCKS * BLOCK_SIZE);
+    float* random = (float*)malloc(sizeof(float) * N_BLOCKS * BLOCK_SIZE);
+    float  search_out[BLOCK_SIZE];
+    float  table_out[BLOCK_SIZE];
+    double sink = 0.0;
+
+    srand(1);
+    for (uint32_t i = 0; i < N_BLOCKS * BLOCK_SIZE; i++) {
+        sweep[i]  = RANGE * (0.5f + 0.5f * sinf((float)i * 1e-4f));
+        random[i] = (rand() % 10001) * 0.001f;
+    }
+
+    CurveTable* curve = (CurveTable*)malloc(sizeof(CurveTable));
+
+    printf("points,levels,search_ns_per_sample,table_ns_per_sample,speedup,max_diff\n");
+
+    for (size_t p = 0; p < sizeof(point_counts) / sizeof(point_counts[0]); p++) {
+        const uint32_t n_points = point_counts[p];
+        float          points[2 * CURVE_MAX_POINTS];
+
+        exponential_points(points, n_points);
+        curve_compile(curve, points, n_points);
+
+        for (int l = 0; l < 2; l++) {
+            const float* levels = l ? random : sweep;
+            double       max_diff = 0.0;
+
+            for (uint32_t b = 0; b < N_BLOCKS; b++) {
+                memcpy(search_out, levels + b * BLOCK_SIZE, sizeof(search_out));
+                memcpy(table_out, levels + b * BLOCK_SIZE, sizeof(table_out));
+                search_render(points, n_points, search_out, BLOCK_SIZE);
+                curve_render(curve, table_out, BLOCK_SIZE, RANGE);
+
+                for (uint32_t i = 0; i < BLOCK_SIZE; i++) {
+                    const double d = fabs((double)search_out[i] - (double)table_out[i]);
+                    max_diff = d > max_diff ? d : max_diff;
+                }
+            }
+
+            double search_ns[REPETITIONS];
+            double table_ns[REPETITIONS];
+
+            for (int r = 0; r < REPETITIONS; r++) {
+                double start = now_ns();
+                for (uint32_t b = 0; b < N_BLOCKS; b++) {
+                    memcpy(search_out, levels + b * BLOCK_SIZE, sizeof(search_out));
+                    search_render(points, n_points, search_out, BLOCK_SIZE);
+                    sink += search_out[BLOCK_SIZE - 1];
+                }
+                search_ns[r] = (now_ns() - start) / ((double)N_BLOCKS * BLOCK_SIZE);
+
+                start = now_ns();
+                for (uint32_t b = 0; b < N_BLOCKS; b++) {
+                    memcpy(table_out, levels + b * BLOCK_SIZE, sizeof(table_out));
+                    curve_render(curve, table_out, BLOCK_SIZE, RANGE);
+                    sink += table_out[BLOCK_SIZE - 1];
+                }
+                table_ns[r] = (now_ns() - start) / ((double)N_BLOCKS * BLOCK_SIZE);
+            }
+
+            qsort(search_ns, REPETITIONS, sizeof(double), cmp_double);
+            qsort(table_ns, REPETITIONS, sizeof(double), cmp_double);
+
+            const double search = search_ns[REPETITIONS / 2];
+            const double table  = table_ns[REPETITIONS / 2];
+
+            printf("%u,%s,%.3f,%.3f,%.1f,%.3g\n",
+                   n_points, l ? "random" : "sweep",
+                   search, table, table > 0.0 ? search / table : 0.0, max_diff);
+            fflush(stdout);
+        }
+    }
+
+    free(curve);
+    free(random);
+    free(sweep);
+
+    // keeps the renders from being optimised away
+    return sink == 0.0;
+}
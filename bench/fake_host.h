@@ -0,0 +1,433 @@
+/*
+  Fake plugin host for the mod-advanced-control-to-cv benchmarks
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+  THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+   The host side the benchmarks that load the plugin binary share: the
+   port indices, a urid:map, log and HMI widget control stubs, a worker that
+   runs scheduled work synchronously after run(), and loading the plugin
+   with dlopen().
+
+   The HMI stubs count their calls.  With host_timing set every host
+   callback also measures the time it takes, into host_ns of the calling
+   thread, and the HMI stubs spin for hmi_delay_ns first, like a host that
+   talks to the HMI synchronously.
+
+   Include it once, from the file with main().
+*/
+
+#ifndef FAKE_HOST_H_INCLUDED
+#define FAKE_HOST_H_INCLUDED
+
+#include <dlfcn.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lv2/atom/atom.h"
+#include "lv2/core/lv2.h"
+#include "lv2/log/log.h"
+#include "lv2/state/state.h"
+#include "lv2/urid/urid.h"
+#include "lv2/worker/worker.h"
+
+#include "lv2-hmi.h"
+
+#define MAX_URIS        256
+#define MAX_WORK_SIZE   256
+
+// must match PortIndex in mod-advanced-control-to-cv.c
+typedef enum {
+    Cvoutput = 0,
+    Knob,
+    Smoothing,
+    Min,
+    Max,
+    PARAMS_IN,
+    PARAMS_OUT,
+    ROUND,
+    SmoothTime,
+    FallTime,
+    Mapping,
+    Invert,
+    ControlRate,
+    Interpolation,
+    ValueEvents,
+    EventThreshold,
+    CvInput,
+    Depth,
+    Quantize,
+    ScaleMask,
+    Hysteresis,
+    ScopeInterval,
+    N_PORTS
+} PortIndex;
+
+/** Features a plugin is instantiated with, besides urid:map. */
+typedef enum {
+    HOST_LOG    = 1 << 0,
+    HOST_HMI    = 1 << 1,
+    HOST_WORKER = 1 << 2
+} HostFeature;
+
+typedef struct {
+    void*                             lib;
+    const LV2_Descriptor*             desc;
+    const LV2_Worker_Interface*       worker;
+    const LV2_State_Interface*        state;
+    const LV2_HMI_PluginNotification* notif;
+
+    LV2_URID_Map          map;
+    LV2_Log_Log           log;
+    LV2_HMI_WidgetControl hmi;
+    LV2_Worker_Schedule   schedule;
+
+    LV2_Feature        map_feature;
+    LV2_Feature        log_feature;
+    LV2_Feature        hmi_feature;
+    LV2_Feature        sched_feature;
+    const LV2_Feature* features[5];
+} FakeHost;
+
+// name of the benchmark, for error messages
+static const char* host_name = "bench";
+
+// --------------------------------------------------------------
+// URIDs
+
+static char*    uri_table[MAX_URIS];
+static uint32_t n_uris = 0;
+
+// mapped by load_plugin(), for the output sequences
+static LV2_URID atom_Chunk = 0;
+
+/** Not thread safe, map what other threads need up front. */
+static LV2_URID
+urid_map(LV2_URID_Map_Handle handle, const char* uri)
+{
+    for (uint32_t i = 0; i < n_uris; i++) {
+        if (!strcmp(uri_table[i], uri))
+            return i + 1;
+    }
+
+    if (n_uris == MAX_URIS) {
+        fprintf(stderr, "%s: URI table full\n", host_name);
+        exit(1);
+    }
+
+    uri_table[n_uris] = strdup(uri);
+    return ++n_uris;
+}
+
+// --------------------------------------------------------------
+// Log and HMI
+
+static bool          host_timing  = false;
+static uint64_t      hmi_delay_ns = 0;
+static unsigned long hmi_calls    = 0;
+
+// time spent in host callbacks, per thread so restore() logging does not count
+static __thread uint64_t host_ns = 0;
+
+static uint64_t
+host_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void
+host_call(uint64_t delay)
+{
+    if (!host_timing)
+        return;
+
+    const uint64_t start = host_now_ns();
+    while (host_now_ns() - start < delay) {
+    }
+    host_ns += host_now_ns() - start;
+}
+
+static void
+hmi_call(void)
+{
+    hmi_calls++;
+    host_call(hmi_delay_ns);
+}
+
+static void
+hmi_set_led_with_blink(LV2_HMI_WidgetControl_Handle handle, LV2_HMI_Addressing addressing,
+                       LV2_HMI_LED_Colour color, int on_blink_time, int off_blink_time)
+{
+    hmi_call();
+}
+
+static void
+hmi_set_led_with_brightness(LV2_HMI_WidgetControl_Handle handle, LV2_HMI_Addressing addressing,
+                            LV2_HMI_LED_Colour color, int brightness)
+{
+    hmi_call();
+}
+
+static void
+hmi_set_text(LV2_HMI_WidgetControl_Handle handle, LV2_HMI_Addressing addressing, const char* text)
+{
+    hmi_call();
+}
+
+static void
+hmi_set_indicator(LV2_HMI_WidgetControl_Handle handle, LV2_HMI_Addressing addressing,
+                  const float indicator_pos)
+{
+    hmi_call();
+}
+
+static void
+hmi_popup_message(LV2_HMI_WidgetControl_Handle handle, LV2_HMI_Addressing addressing,
+                  int style, const char* title, const char* message)
+{
+    hmi_call();
+}
+
+static int
+log_vprintf(LV2_Log_Handle handle, LV2_URID type, const char* fmt, va_list ap)
+{
+    host_call(0);
+    return 0;
+}
+
+static int
+log_printf(LV2_Log_Handle handle, LV2_URID type, const char* fmt, ...)
+{
+    host_call(0);
+    return 0;
+}
+
+// --------------------------------------------------------------
+// Worker
+
+static uint8_t  work_data[MAX_WORK_SIZE];
+static uint32_t work_size = 0;
+static bool     work_requested = false;
+
+static uint8_t  response_data[MAX_WORK_SIZE];
+static uint32_t response_size = 0;
+static bool     response_pending = false;
+
+static LV2_Worker_Status
+schedule_work(LV2_Worker_Schedule_Handle handle, uint32_t size, const void* data)
+{
+    if (work_requested || size > MAX_WORK_SIZE)
+        return LV2_WORKER_ERR_NO_SPACE;
+
+    memcpy(work_data, data, size);
+    work_size = size;
+    work_requested = true;
+    return LV2_WORKER_SUCCESS;
+}
+
+static LV2_Worker_Status
+worker_respond(LV2_Worker_Respond_Handle handle, uint32_t size, const void* data)
+{
+    if (response_pending || size > MAX_WORK_SIZE)
+        return LV2_WORKER_ERR_NO_SPACE;
+
+    memcpy(response_data, data, size);
+    response_size = size;
+    response_pending = true;
+    return LV2_WORKER_SUCCESS;
+}
+
+/** Run the work the last run() scheduled, if any, and deliver its response. */
+static inline void
+run_work(const FakeHost* host, LV2_Handle instance)
+{
+    if (!work_requested)
+        return;
+
+    work_requested = false;
+    host->worker->work(instance, worker_respond, NULL, work_size, work_data);
+    if (response_pending) {
+        response_pending = false;
+        host->worker->work_response(instance, response_size, response_data);
+    }
+}
+
+// --------------------------------------------------------------
+// Plugin
+
+/** Open the plugin binary at path and take its first descriptor, false with a message on failure. */
+static bool
+load_plugin(FakeHost* host, const char* path)
+{
+    memset(host, 0, sizeof(*host));
+
+    host->lib = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!host->lib) {
+        fprintf(stderr, "%s: %s\n", host_name, dlerror());
+        return false;
+    }
+
+    LV2_Descriptor_Function descriptor_fn =
+        (LV2_Descriptor_Function)dlsym(host->lib, "lv2_descriptor");
+    host->desc = descriptor_fn ? descriptor_fn(0) : NULL;
+    if (!host->desc) {
+        fprintf(stderr, "%s: no plugin descriptor in %s\n", host_name, path);
+        dlclose(host->lib);
+        return false;
+    }
+
+    if (host->desc->extension_data) {
+        host->worker = (const LV2_Worker_Interface*)host->desc->extension_data(LV2_WORKER__interface);
+        host->state  = (const LV2_State_Interface*)host->desc->extension_data(LV2_STATE__interface);
+        host->notif  = (const LV2_HMI_PluginNotification*)
+                           host->desc->extension_data(LV2_HMI__PluginNotification);
+    }
+
+    host->map.handle = NULL;
+    host->map.map    = urid_map;
+    atom_Chunk       = urid_map(NULL, LV2_ATOM__Chunk);
+
+    host->log.handle  = NULL;
+    host->log.printf  = log_printf;
+    host->log.vprintf = log_vprintf;
+
+    host->hmi.handle                     = NULL;
+    host->hmi.size                       = sizeof(LV2_HMI_WidgetControl);
+    host->hmi.set_led_with_blink         = hmi_set_led_with_blink;
+    host->hmi.set_led_with_brightness    = hmi_set_led_with_brightness;
+    host->hmi.set_label                  = hmi_set_text;
+    host->hmi.set_value                  = hmi_set_text;
+    host->hmi.set_unit                   = hmi_set_text;
+    host->hmi.set_indicator              = hmi_set_indicator;
+    host->hmi.popup_message              = hmi_popup_message;
+
+    host->schedule.handle        = NULL;
+    host->schedule.schedule_work = schedule_work;
+
+    host->map_feature.URI    = LV2_URID__map;
+    host->map_feature.data   = &host->map;
+    host->log_feature.URI    = LV2_LOG__log;
+    host->log_feature.data   = &host->log;
+    host->hmi_feature.URI    = LV2_HMI__WidgetControl;
+    host->hmi_feature.data   = &host->hmi;
+    host->sched_feature.URI  = LV2_WORKER__schedule;
+    host->sched_feature.data = &host->schedule;
+
+    return true;
+}
+
+/** The NULL terminated features of a HostFeature mask, valid until the next call. */
+static const LV2_Feature* const*
+host_features(FakeHost* host, unsigned mask)
+{
+    uint32_t n = 0;
+
+    host->features[n++] = &host->map_feature;
+    if (mask & HOST_LOG)
+        host->features[n++] = &host->log_feature;
+    if (mask & HOST_HMI)
+        host->features[n++] = &host->hmi_feature;
+    if (mask & HOST_WORKER)
+        host->features[n++] = &host->sched_feature;
+    host->features[n] = NULL;
+
+    return host->features;
+}
+
+static void
+unload_plugin(FakeHost* host)
+{
+    dlclose(host->lib);
+
+    for (uint32_t i = 0; i < n_uris; i++)
+        free(uri_table[i]);
+    n_uris = 0;
+}
+
+/**
+   Set controls, N_PORTS values, to the values every benchmark starts from
+   and connect each control port to its value and the other ports to the
+   given buffers.  The CV input is left unconnected.
+*/
+static inline void
+connect_all(const LV2_Descriptor* desc, LV2_Handle instance, float* controls,
+            float* output, void* params_in, void* params_out)
+{
+    controls[Knob]           = 0.0f;
+    controls[Smoothing]      = 1.0f;
+    controls[Min]            = 0.0f;
+    controls[Max]            = 100.0f;
+    controls[ROUND]          = 0.0f;
+    controls[SmoothTime]     = 5.0f;
+    controls[FallTime]       = 10.0f;
+    controls[Mapping]        = 1.0f;
+    controls[Invert]         = 0.0f;
+    controls[ControlRate]    = 1.0f;
+    controls[Interpolation]  = 0.0f;
+    controls[ValueEvents]    = 0.0f;
+    controls[EventThreshold] = 0.001f;
+    controls[Depth]          = 0.0f;
+    controls[Quantize]       = 0.0f;
+    controls[ScaleMask]      = 2741.0f;
+    controls[Hysteresis]     = 0.1f;
+    controls[ScopeInterval]  = 0.0f;
+
+    for (uint32_t port = 0; port < N_PORTS; port++)
+        desc->connect_port(instance, port, &controls[port]);
+
+    desc->connect_port(instance, Cvoutput,   output);
+    desc->connect_port(instance, PARAMS_IN,  params_in);
+    desc->connect_port(instance, PARAMS_OUT, params_out);
+    desc->connect_port(instance, CvInput,    NULL);
+}
+
+/** Address the knob to the fake HMI, like a host does once the instance runs. */
+static inline void
+address_knob(FakeHost* host, LV2_Handle instance)
+{
+    if (!host->notif)
+        return;
+
+    const LV2_HMI_AddressingInfo info = {
+        LV2_HMI_AddressingCapability_Value | LV2_HMI_AddressingCapability_Unit,
+        0, "Control", 0.0f, 10.0f, 201
+    };
+    host->notif->addressed(instance, Knob, (LV2_HMI_Addressing)&host->hmi, &info);
+}
+
+/** An empty sequence, the input of an instance that gets no events. */
+static inline void
+empty_sequence(LV2_Atom_Sequence* seq)
+{
+    seq->atom.type = urid_map(NULL, LV2_ATOM__Sequence);
+    seq->atom.size = sizeof(LV2_Atom_Sequence_Body);
+    seq->body.unit = 0;
+    seq->body.pad  = 0;
+}
+
+/** Hand an output sequence of capacity bytes back to the plugin before run(). */
+static inline void
+reset_output(LV2_Atom_Sequence* seq, uint32_t capacity)
+{
+    seq->atom.type = atom_Chunk;
+    seq->atom.size = capacity - sizeof(LV2_Atom);
+}
+
+#endif /* FAKE_HOST_H_INCLUDED */
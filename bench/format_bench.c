@@ -0,0 +1,209 @@
+/*
+  Number formatting benchmark for mod-advanced-control-to-cv
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+  THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+   Times format_int() and format_fixed() from num_format.h against snprintf().
+
+   Before timing, every value that is benchmarked is formatted by both and
+   compared, the run is aborted on the first difference.  The values cover
+   the whole -100000..100000 range of the Min/Max ports: every integer, every
+   display step of each precision the HMI uses, random float bit patterns and
+   the special values NaN, infinity, negative zero and out of range numbers.
+
+   Results are printed to stdout as CSV, one line per case:
+   function,precision,calls,ns_per_call
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "num_format.h"
+
+#define RANGE           100000
+#define BUFFER_SIZE     32
+#define RANDOM_VALUES   1000000
+
+static double
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static float
+float_from_bits(uint32_t bits)
+{
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static unsigned long n_checked = 0;
+
+static void
+check_fixed(float value, uint8_t precision)
+{
+    char ours[BUFFER_SIZE];
+    char ref[BUFFER_SIZE];
+
+    format_fixed(value, precision, ours, sizeof(ours));
+    snprintf(ref, sizeof(ref), "%.*f", precision, (double)value);
+
+    if (strcmp(ours, ref)) {
+        fprintf(stderr, "format_fixed(%.9g, %u) = \"%s\", snprintf gives \"%s\"\n",
+                value, precision, ours, ref);
+        exit(1);
+    }
+
+    n_checked++;
+}
+
+static void
+check_int(int64_t value)
+{
+    char ours[BUFFER_SIZE];
+    char ref[BUFFER_SIZE];
+
+    format_int(value, ours, sizeof(ours));
+    snprintf(ref, sizeof(ref), "%lld", (long long)value);
+
+    if (strcmp(ours, ref)) {
+        fprintf(stderr, "format_int(%lld) = \"%s\", snprintf gives \"%s\"\n",
+                (long long)value, ours, ref);
+        exit(1);
+    }
+
+    n_checked++;
+}
+
+static void
+check_all(void)
+{
+    for (int64_t i = -RANGE; i <= RANGE; i++)
+        check_int(i);
+
+    check_int(INT64_MIN);
+    check_int(INT64_MAX);
+
+    // every display step, at the precision the HMI uses for that magnitude
+    for (int32_t i = -RANGE * 10; i <= RANGE * 10; i++)
+        check_fixed(i / 10.0f, 1);
+    for (int32_t i = -100 * 100; i <= 100 * 100; i++)
+        check_fixed(i / 100.0f, 2);
+    for (int32_t i = -10 * 1000; i <= 10 * 1000; i++)
+        check_fixed(i / 1000.0f, 3);
+
+    srand(1);
+    for (int i = 0; i < RANDOM_VALUES; i++) {
+        const uint32_t bits = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+        const float    value = float_from_bits(bits);
+        if (value >= -RANGE && value <= RANGE) {
+            for (uint8_t p = 0; p <= 3; p++)
+                check_fixed(value, p);
+        }
+    }
+
+    const float specials[] = {
+        0.0f, -0.0f, 0.0005f, -0.0005f, 0.0625f, -0.0625f, 9.9995f, 99.995f,
+        1e-30f, -1e-30f, 4294967296.0f, -4294967296.0f,
+        float_from_bits(0x7f800000), float_from_bits(0xff800000),
+        float_from_bits(0x7fc00000), float_from_bits(0xffc00000),
+    };
+    for (size_t i = 0; i < sizeof(specials) / sizeof(specials[0]); i++) {
+        for (uint8_t p = 0; p <= NUM_FORMAT_MAX_PRECISION; p++)
+            check_fixed(specials[i], p);
+    }
+
+    // out of range and too long for the buffer fail with an empty string
+    char bfr[8];
+    if (format_fixed(1e30f, 1, bfr, sizeof(bfr)) || bfr[0] ||
+        format_fixed(1e18f, 3, bfr, sizeof(bfr)) || bfr[0] ||
+        format_fixed(-100000.0f, 1, bfr, sizeof(bfr)) || bfr[0] ||
+        format_int(-1000000, bfr, sizeof(bfr)) || bfr[0]) {
+        fprintf(stderr, "overflow is not reported\n");
+        exit(1);
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    check_all();
+    fprintf(stderr, "format_bench: %lu values match snprintf\n", n_checked);
+
+    const uint32_t n_values = 1 << 16;
+    float*   values  = (float*)malloc(sizeof(float) * n_values);
+    int32_t* ivalues = (int32_t*)malloc(sizeof(int32_t) * n_values);
+
+    srand(2);
+    for (uint32_t i = 0; i < n_values; i++) {
+        values[i]  = (rand() % (2 * RANGE * 10 + 1) - RANGE * 10) / 10.0f;
+        ivalues[i] = rand() % (2 * RANGE + 1) - RANGE;
+    }
+
+    char bfr[BUFFER_SIZE];
+    unsigned long sink = 0;
+    const int repetitions = 16;
+
+    printf("function,precision,calls,ns_per_call\n");
+
+    for (uint8_t p = 0; p <= 3; p++) {
+        double start = now_ns();
+        for (int r = 0; r < repetitions; r++) {
+            for (uint32_t i = 0; i < n_values; i++)
+                sink += format_fixed(values[i], p, bfr, sizeof(bfr));
+        }
+        const double ours = (now_ns() - start) / (repetitions * (double)n_values);
+
+        start = now_ns();
+        for (int r = 0; r < repetitions; r++) {
+            for (uint32_t i = 0; i < n_values; i++)
+                sink += snprintf(bfr, sizeof(bfr), "%.*f", p, (double)values[i]);
+        }
+        const double ref = (now_ns() - start) / (repetitions * (double)n_values);
+
+        printf("format_fixed,%u,%u,%.2f\n", p, repetitions * n_values, ours);
+        printf("snprintf_f,%u,%u,%.2f\n", p, repetitions * n_values, ref);
+    }
+
+    double start = now_ns();
+    for (int r = 0; r < repetitions; r++) {
+        for (uint32_t i = 0; i < n_values; i++)
+            sink += format_int(ivalues[i], bfr, sizeof(bfr));
+    }
+    const double ours = (now_ns() - start) / (repetitions * (double)n_values);
+
+    start = now_ns();
+    for (int r = 0; r < repetitions; r++) {
+        for (uint32_t i = 0; i < n_values; i++)
+            sink += snprintf(bfr, sizeof(bfr), "%d", ivalues[i]);
+    }
+    const double ref = (now_ns() - start) / (repetitions * (double)n_values);
+
+    printf("format_int,0,%u,%.2f\n", repetitions * n_values, ours);
+    printf("snprintf_d,0,%u,%.2f\n", repetitions * n_values, ref);
+
+    free(values);
+    free(ivalues);
+
+    // keeps the formatting calls from being optimised away
+    return sink == 0;
+}
@@ -0,0 +1,242 @@
+/*
+  Many-instance benchmark for mod-advanced-control-to-cv
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+  THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+   Loads the plugin binary with dlopen() and runs a pedalboard's worth of
+   instances, one block each in turn like a host does, so the instances
+   compete for the cache the way they do on a device.
+
+   For every instance count the heap the instances take is measured with
+   mallinfo2(), and run() is timed.  Where the kernel allows it the L1 data
+   cache read misses and the last level cache misses of run() are counted
+   with perf_event_open(), otherwise they are reported as -1.
+
+   Usage: instances_bench PLUGIN.so [RUNS_PER_CASE]
+
+   Results are printed to stdout as CSV, one line per instance count:
+   instances,bytes_per_instance,ns_per_run,l1d_misses_per_run,llc_misses_per_run
+   The reported numbers are the median of several repetitions.
+*/
+
+#define _GNU_SOURCE
+
+#include <linux/perf_event.h>
+#include <malloc.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "fake_host.h"
+
+#define BLOCK_SIZE      128
+#define OUT_CAPACITY    4096
+#define REPETITIONS     7
+#define SAMPLE_RATE     48000.0
+
+static const uint32_t instance_counts[] = { 1, 16, 128, 512 };
+
+/** Buffers and control values of one instance. */
+typedef struct {
+    LV2_Handle handle;
+    float      controls[N_PORTS];
+    float      output[BLOCK_SIZE];
+    uint64_t   out_buf[OUT_CAPACITY / sizeof(uint64_t)];
+} Instance;
+
+static double
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int
+cmp_double(const void* a, const void* b)
+{
+    const double da = *(const double*)a;
+    const double db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+/** A user space counter of this thread, -1 if the kernel refuses it. */
+static int
+open_counter(uint32_t type, uint64_t config)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = type;
+    attr.config         = config;
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void
+start_counter(int fd)
+{
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+static double
+stop_counter(int fd)
+{
+    uint64_t count = 0;
+    if (fd < 0)
+        return -1.0;
+
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &count, sizeof(count)) != sizeof(count))
+        return -1.0;
+
+    return (double)count;
+}
+
+static size_t
+heap_in_use(void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return mallinfo2().uordblks;
+#else
+    return (size_t)mallinfo().uordblks;
+#endif
+}
+
+int
+main(int argc, char** argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s PLUGIN.so [RUNS_PER_CASE]\n", argv[0]);
+        return 1;
+    }
+
+    const uint32_t runs_per_case = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 1 << 16;
+
+    host_name = "instances_bench";
+
+    FakeHost host;
+    if (!load_plugin(&host, argv[1]))
+        return 1;
+
+    const LV2_Descriptor* desc = host.desc;
+
+    LV2_Atom_Sequence in_seq;
+    empty_sequence(&in_seq);
+
+    const int l1d_fd = open_counter(PERF_TYPE_HW_CACHE,
+                                    PERF_COUNT_HW_CACHE_L1D |
+                                    (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    const int llc_fd = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+
+    printf("instances,bytes_per_instance,ns_per_run,l1d_misses_per_run,llc_misses_per_run\n");
+
+    for (size_t c = 0; c < sizeof(instance_counts) / sizeof(instance_counts[0]); c++) {
+        const uint32_t n_instances = instance_counts[c];
+        const uint32_t n_blocks    = runs_per_case > n_instances ? runs_per_case / n_instances : 1;
+        Instance*      instances   = (Instance*)calloc(n_instances, sizeof(Instance));
+
+        // only what instantiate() allocates, the host side buffers are above
+        const size_t heap_before = heap_in_use();
+        for (uint32_t i = 0; i < n_instances; i++) {
+            instances[i].handle = desc->instantiate(desc, SAMPLE_RATE, "", host_features(&host, 0));
+            if (!instances[i].handle) {
+                fprintf(stderr, "instances_bench: instantiate failed\n");
+                return 1;
+            }
+        }
+        const size_t heap_after = heap_in_use();
+
+        for (uint32_t i = 0; i < n_instances; i++) {
+            Instance* inst = &instances[i];
+            connect_all(desc, inst->handle, inst->controls, inst->output, &in_seq, inst->out_buf);
+            if (desc->activate)
+                desc->activate(instances[i].handle);
+        }
+
+        double times[REPETITIONS];
+        double l1d[REPETITIONS];
+        double llc[REPETITIONS];
+
+        for (int r = 0; r < REPETITIONS; r++) {
+            double elapsed = 0.0;
+            double l1d_sum = 0.0;
+            double llc_sum = 0.0;
+
+            for (uint32_t b = 0; b < n_blocks; b++) {
+                // every instance moves its knob, so every smoother runs
+                for (uint32_t i = 0; i < n_instances; i++) {
+                    Instance* inst = &instances[i];
+                    inst->controls[Knob] = (float)((b + i) % 11);
+
+                    reset_output((LV2_Atom_Sequence*)inst->out_buf, OUT_CAPACITY);
+                }
+
+                start_counter(l1d_fd);
+                start_counter(llc_fd);
+                const double start = now_ns();
+
+                for (uint32_t i = 0; i < n_instances; i++)
+                    desc->run(instances[i].handle, BLOCK_SIZE);
+
+                elapsed += now_ns() - start;
+                l1d_sum += stop_counter(l1d_fd);
+                llc_sum += stop_counter(llc_fd);
+            }
+
+            const double runs = (double)n_blocks * n_instances;
+            times[r] = elapsed / runs;
+            l1d[r]   = l1d_fd >= 0 ? l1d_sum / runs : -1.0;
+            llc[r]   = llc_fd >= 0 ? llc_sum / runs : -1.0;
+        }
+
+        qsort(times, REPETITIONS, sizeof(double), cmp_double);
+        qsort(l1d, REPETITIONS, sizeof(double), cmp_double);
+        qsort(llc, REPETITIONS, sizeof(double), cmp_double);
+
+        printf("%u,%zu,%.1f,%.1f,%.1f\n",
+               n_instances, (heap_after - heap_before) / n_instances,
+               times[REPETITIONS / 2], l1d[REPETITIONS / 2], llc[REPETITIONS / 2]);
+        fflush(stdout);
+
+        for (uint32_t i = 0; i < n_instances; i++) {
+            if (desc->deactivate)
+                desc->deactivate(instances[i].handle);
+            desc->cleanup(instances[i].handle);
+        }
+        free(instances);
+    }
+
+    if (l1d_fd >= 0)
+        close(l1d_fd);
+    if (llc_fd >= 0)
+        close(llc_fd);
+
+    unload_plugin(&host);
+
+    return 0;
+}
@@ -0,0 +1,310 @@
+/*
+  Render kernel benchmark for mod-advanced-control-to-cv
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+  THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+   Times the specialised kernels smoother_render() picks from its table
+   against a generic loop that looks at the mode and the mapping for every
+   sample, the way run() rendered before.
+
+   Mode and mapping are read through port pointers in the generic loop, as
+   they were, so they are loaded again for every sample.  The knob moves to a
+   new random level every block of 128 samples, the smoothing time is 10 ms.
+   The output is either the knob level or mapped to a range.
+
+   Results are printed to stdout as CSV, one line per case:
+   mode,mapping,generic_ns_per_sample,kernel_ns_per_sample,speedup,max_diff
+   max_diff is the largest difference between both outputs, the generic loop
+   runs the filters per sample in float and drifts from the closed forms.
+   Mapped to the range it is in output units, ten times that of the knob.
+
+   Then the one-pole kernel at the default time is compared with the filter
+   it replaced, which took one step of a 550 Hz pole per block and held it,
+   at several block sizes:
+   block_size,mapping,stepped_max_diff,block_end_max_diff,reference_max_diff
+   stepped_max_diff is the largest difference to the stepped filter over all
+   samples, block_end_max_diff only at the last sample of every block, where
+   both have taken the same glide.  reference_max_diff is the largest
+   difference to the per-sample recurrence evaluated in double.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "smoothing.h"
+
+#define SAMPLE_RATE     48000.0
+#define SMOOTH_TIME_MS  10.0f
+#define BLOCK_SIZE      128
+#define N_BLOCKS        4096
+#define REPETITIONS     5
+
+// range mapping of 0..10 to -50..50
+#define RANGE_GAIN      10.0f
+#define RANGE_OFFSET    -50.0f
+
+// pole of the filter the one-pole kernel replaced
+#define STEPPED_FREQUENCY 550.0
+#define TWO_PI            6.283185307179586
+
+static const char* const mode_names[SMOOTH_MODE_COUNT] = {
+    "off",
+    "one-pole",
+    "two-pole",
+    "linear",
+    "slew",
+};
+
+/** State of the generic loop, one set of variables for all modes. */
+typedef struct {
+    float a0, b1, a0_half, b1_half, z1, z2;
+    float ramp_target, ramp_step, value;
+    uint32_t ramp_left, ramp_samples;
+    float rise_step, fall_step;
+} Generic;
+
+static void
+generic_init(Generic* g)
+{
+    const double samples = SMOOTH_TIME_MS * 0.001 * SAMPLE_RATE;
+
+    memset(g, 0, sizeof(*g));
+    g->b1           = (float)exp(-1.0 / samples);
+    g->a0           = 1.0f - g->b1;
+    g->b1_half      = (float)exp(-2.0 / samples);
+    g->a0_half      = 1.0f - g->b1_half;
+    g->ramp_samples = (uint32_t)lrint(samples);
+    g->rise_step    = 10.0f / (float)samples;
+    g->fall_step    = g->rise_step;
+}
+
+/** Every sample branches on the mode and the mapping, read from their ports. */
+static void
+generic_render(Generic* g, const float* mode_port, const float* mapping_port,
+               float target, float* out, uint32_t n_samples)
+{
+    for (uint32_t i = 0; i < n_samples; i++) {
+        float v;
+
+        switch ((int)*mode_port) {
+            case SMOOTH_ONE_POLE:
+                v = g->z1 = target * g->a0 + g->z1 * g->b1;
+                break;
+
+            case SMOOTH_TWO_POLE:
+                // two stages of half the time constant
+                g->z1 = target * g->a0_half + g->z1 * g->b1_half;
+                v = g->z2 = g->z1 * g->a0_half + g->z2 * g->b1_half;
+                break;
+
+            case SMOOTH_LINEAR:
+                if (target != g->ramp_target) {
+                    g->ramp_target = target;
+                    g->ramp_left   = g->ramp_samples;
+                    g->ramp_step   = (target - g->value) / (float)g->ramp_samples;
+                }
+                if (g->ramp_left) {
+                    g->ramp_left--;
+                    g->value = g->ramp_left ? g->value + g->ramp_step : target;
+                }
+                v = g->value;
+                break;
+
+            case SMOOTH_SLEW: {
+                const float d    = target - g->value;
+                const float step = d > 0.0f ? g->rise_step : -g->fall_step;
+                g->value = d / step <= 1.0f ? target : g->value + step;
+                v = g->value;
+                break;
+            }
+
+            default:
+                v = target;
+                break;
+        }
+
+        out[i] = (int)*mapping_port == 1 ? v * RANGE_GAIN + RANGE_OFFSET : v;
+    }
+}
+
+/**
+   The filter run() had before the kernel.  Its output was fed back as the
+   input, so it took one step towards the target at the start of every block
+   and held the value for the rest of it.
+*/
+static void
+stepped_render(double* z1, float target, float* out, uint32_t n_samples)
+{
+    const double b1 = exp(-TWO_PI * STEPPED_FREQUENCY / SAMPLE_RATE);
+
+    *z1 = target * (1.0 - b1) + *z1 * b1;
+    for (uint32_t i = 0; i < n_samples; i++)
+        out[i] = (float)*z1;
+}
+
+/** The one-pole at the default time per sample, in double. */
+static void
+reference_render(double* z1, float target, float* out, uint32_t n_samples)
+{
+    const double b1 = exp(-1.0 / (SMOOTH_TIME_DEFAULT * 0.001 * SAMPLE_RATE));
+
+    for (uint32_t i = 0; i < n_samples; i++) {
+        *z1    = target * (1.0 - b1) + *z1 * b1;
+        out[i] = (float)*z1;
+    }
+}
+
+/** The one-pole kernel against the stepped filter it replaced and the reference. */
+static void
+compare_stepped(const float* targets)
+{
+    static const uint32_t block_sizes[] = { 64, 128, 256 };
+
+    printf("block_size,mapping,stepped_max_diff,block_end_max_diff,reference_max_diff\n");
+
+    for (unsigned k = 0; k < sizeof(block_sizes) / sizeof(block_sizes[0]); k++) {
+        const uint32_t block_size = block_sizes[k];
+
+        for (int mapping = 0; mapping <= 1; mapping++) {
+            const float gain   = mapping ? RANGE_GAIN : 1.0f;
+            const float offset = mapping ? RANGE_OFFSET : 0.0f;
+
+            float    kernel_out[256], stepped_out[256], reference_out[256];
+            double   stepped_z1 = 0.0, reference_z1 = 0.0;
+            double   stepped_max = 0.0, end_max = 0.0, reference_max = 0.0;
+            Smoother s;
+
+            smoother_init(&s, SAMPLE_RATE, 10.0f, SMOOTH_ONE_POLE, SMOOTH_TIME_DEFAULT, SMOOTH_TIME_DEFAULT);
+
+            for (uint32_t b = 0; b < N_BLOCKS; b++) {
+                smoother_render(&s, targets[b], gain, offset, kernel_out, block_size);
+                stepped_render(&stepped_z1, targets[b], stepped_out, block_size);
+                reference_render(&reference_z1, targets[b], reference_out, block_size);
+
+                for (uint32_t i = 0; i < block_size; i++) {
+                    const double stepped   = fabs(kernel_out[i] - (stepped_out[i] * gain + offset));
+                    const double reference = fabs(kernel_out[i] - (reference_out[i] * gain + offset));
+
+                    stepped_max   = stepped > stepped_max ? stepped : stepped_max;
+                    reference_max = reference > reference_max ? reference : reference_max;
+                    if (i == block_size - 1)
+                        end_max = stepped > end_max ? stepped : end_max;
+                }
+            }
+
+            printf("%u,%s,%.3g,%.3g,%.3g\n", block_size, mapping ? "range" : "knob",
+                   stepped_max, end_max, reference_max);
+        }
+    }
+}
+
+static double
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int
+cmp_double(const void* a, const void* b)
+{
+    const double da = *(const double*)a;
+    const double db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+int
+main(int argc, char** argv)
+{
+    float* targets = (float*)malloc(sizeof(float) * N_BLOCKS);
+    float  generic_out[BLOCK_SIZE];
+    float  kernel_out[BLOCK_SIZE];
+    double sink = 0.0;
+
+    srand(1);
+    for (uint32_t b = 0; b < N_BLOCKS; b++)
+        targets[b] = (rand() % 10001) * 0.001f;
+
+    printf("mode,mapping,generic_ns_per_sample,kernel_ns_per_sample,speedup,max_diff\n");
+
+    for (int mode = SMOOTH_OFF; mode < SMOOTH_MODE_COUNT; mode++) {
+        for (int mapping = 0; mapping <= 1; mapping++) {
+            const float mode_port    = (float)mode;
+            const float mapping_port = (float)mapping;
+            const float gain         = mapping ? RANGE_GAIN : 1.0f;
+            const float offset       = mapping ? RANGE_OFFSET : 0.0f;
+
+            // both renders side by side, to compare them
+            Generic  g;
+            Smoother s;
+            double   max_diff = 0.0;
+
+            generic_init(&g);
+            smoother_init(&s, SAMPLE_RATE, 10.0f, (SmoothMode)mode, SMOOTH_TIME_MS, SMOOTH_TIME_MS);
+
+            for (uint32_t b = 0; b < N_BLOCKS; b++) {
+                generic_render(&g, &mode_port, &mapping_port, targets[b], generic_out, BLOCK_SIZE);
+                smoother_render(&s, targets[b], gain, offset, kernel_out, BLOCK_SIZE);
+
+                for (uint32_t i = 0; i < BLOCK_SIZE; i++) {
+                    const double d = fabs((double)generic_out[i] - (double)kernel_out[i]);
+                    max_diff = d > max_diff ? d : max_diff;
+                }
+            }
+
+            double generic_ns[REPETITIONS];
+            double kernel_ns[REPETITIONS];
+
+            for (int r = 0; r < REPETITIONS; r++) {
+                generic_init(&g);
+                double start = now_ns();
+                for (uint32_t b = 0; b < N_BLOCKS; b++)
+                    generic_render(&g, &mode_port, &mapping_port, targets[b], generic_out, BLOCK_SIZE);
+                generic_ns[r] = (now_ns() - start) / ((double)N_BLOCKS * BLOCK_SIZE);
+                sink += generic_out[BLOCK_SIZE - 1];
+
+                smoother_init(&s, SAMPLE_RATE, 10.0f, (SmoothMode)mode, SMOOTH_TIME_MS, SMOOTH_TIME_MS);
+                start = now_ns();
+                for (uint32_t b = 0; b < N_BLOCKS; b++)
+                    smoother_render(&s, targets[b], gain, offset, kernel_out, BLOCK_SIZE);
+                kernel_ns[r] = (now_ns() - start) / ((double)N_BLOCKS * BLOCK_SIZE);
+                sink += kernel_out[BLOCK_SIZE - 1];
+            }
+
+            qsort(generic_ns, REPETITIONS, sizeof(double), cmp_double);
+            qsort(kernel_ns, REPETITIONS, sizeof(double), cmp_double);
+
+            const double generic = generic_ns[REPETITIONS / 2];
+            const double kernel  = kernel_ns[REPETITIONS / 2];
+
+            printf("%s,%s,%.3f,%.3f,%.1f,%.3g\n",
+                   mode_names[mode], mapping ? "range" : "knob",
+                   generic, kernel, kernel > 0.0 ? generic / kernel : 0.0, max_diff);
+            fflush(stdout);
+        }
+    }
+
+    compare_stepped(targets);
+    free(targets);
+
+    // keeps the renders from being optimised away
+    return sink == 0.0;
+}
@@ -0,0 +1,451 @@
+/*
+  Worst-case run() latency profiler for mod-advanced-control-to-cv
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+  THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+   Loads the plugin binary with dlopen() and records the latency of every
+   run() call in a histogram, to show the tail rather than the average.
+
+   The fake HMI widget control spins for a configurable time in each call,
+   like a host that talks to the HMI synchronously.  Time spent in host
+   callbacks (HMI and log) during run() is measured on its own, so each
+   block is split into the host part and the rest, which is the DSP and
+   event handling of the plugin.
+
+   With stress on, a second thread follows the audio thread block by block.
+   It moves the knob every block, floods the plugin with patch:Set messages
+   every few blocks and calls restore() while the next run() is under way.
+   Knob moves and patch:Set messages reach run() as events on its control
+   port, through a lock-free queue the audio thread drains before each block.
+   restore() is called directly from the second thread, after it has queued
+   the events of the next block, so it overlaps with that run().  The blocks
+   are not paced to the sample rate, the audio thread only waits until the
+   events of the next block are queued.
+
+   With the worker feature, scheduled work runs synchronously after run(),
+   like in bench.c, and is reported as its own component.
+
+   Usage: latency PLUGIN.so [BLOCKS] [BLOCK_SIZE]
+
+   Results are printed to stdout as CSV, one line per case and component:
+   worker,hmi_delay_us,stress,component,blocks,p50_ns,p99_ns,p999_ns,max_ns
+   The component is run, host (callbacks within run), dsp (run minus host)
+   or work.  Percentiles are bucket upper bounds, accurate to 1/8 octave.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lv2/atom/forge.h"
+#include "lv2/patch/patch.h"
+
+#include "fake_host.h"
+
+#define PLUGIN_URI      "http://moddevices.com/plugins/mod-devel/mod-advanced-control-to-cv"
+#define UNIT_STRING_URI PLUGIN_URI "#unitstring"
+
+#define MAX_BLOCK_SIZE  2048
+#define IN_CAPACITY     8192
+#define OUT_CAPACITY    8192
+#define SAMPLE_RATE     48000.0
+
+// commands from the stress thread
+#define QUEUE_SIZE      1024
+#define EVENTS_PER_RUN  64
+#define FLOOD_SETS      32
+#define FLOOD_EVERY     8       // blocks between patch:Set floods
+#define RESTORE_EVERY   16      // blocks between restore() calls
+
+// histogram, 8 buckets per octave from 1 ns up to 2^40 ns
+#define HIST_SUB        8
+#define HIST_OCTAVES    40
+#define HIST_BUCKETS    (HIST_SUB * HIST_OCTAVES)
+
+typedef enum {
+    COMPONENT_RUN = 0,
+    COMPONENT_HOST,
+    COMPONENT_DSP,
+    COMPONENT_WORK,
+    COMPONENT_COUNT
+} Component;
+
+static const char* const component_names[COMPONENT_COUNT] = {
+    "run",
+    "host",
+    "dsp",
+    "work",
+};
+
+typedef struct {
+    uint64_t count;
+    uint64_t max;
+    uint64_t buckets[HIST_BUCKETS];
+} Histogram;
+
+typedef enum {
+    COMMAND_KNOB = 0,
+    COMMAND_SET_UNIT
+} CommandType;
+
+typedef struct {
+    CommandType type;
+    float       value;
+} Command;
+
+/** Single producer, single consumer queue from the stress thread to the audio thread. */
+typedef struct {
+    Command     commands[QUEUE_SIZE];
+    atomic_uint head;
+    atomic_uint tail;
+} CommandQueue;
+
+typedef struct {
+    const LV2_State_Interface* state;
+    LV2_Handle                 instance;
+    CommandQueue               queue;
+    atomic_uint_fast64_t       blocks;
+    atomic_uint_fast64_t       queued;
+    atomic_bool                stop;
+    uint64_t                   restores;
+} Stress;
+
+// --------------------------------------------------------------
+// Histogram
+
+static uint32_t
+hist_bucket(uint64_t ns)
+{
+    if (ns < HIST_SUB)
+        return (uint32_t)ns;
+
+    const uint32_t octave = 63 - (uint32_t)__builtin_clzll(ns);
+    const uint32_t sub    = (uint32_t)(ns >> (octave - 3)) & (HIST_SUB - 1);
+    const uint32_t bucket = (octave - 2) * HIST_SUB + sub;
+
+    return bucket < HIST_BUCKETS ? bucket : HIST_BUCKETS - 1;
+}
+
+/** The largest value that falls into bucket. */
+static uint64_t
+hist_bucket_limit(uint32_t bucket)
+{
+    if (bucket < HIST_SUB)
+        return bucket;
+
+    const uint32_t octave = bucket / HIST_SUB + 2;
+    const uint64_t sub    = bucket % HIST_SUB;
+
+    return ((HIST_SUB + sub + 1) << (octave - 3)) - 1;
+}
+
+static void
+hist_record(Histogram* hist, uint64_t ns)
+{
+    hist->buckets[hist_bucket(ns)]++;
+    hist->count++;
+    if (ns > hist->max)
+        hist->max = ns;
+}
+
+static uint64_t
+hist_percentile(const Histogram* hist, double percentile)
+{
+    const uint64_t rank = (uint64_t)(hist->count * percentile / 100.0);
+    uint64_t       seen = 0;
+
+    for (uint32_t i = 0; i < HIST_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen > rank)
+            return hist_bucket_limit(i) < hist->max ? hist_bucket_limit(i) : hist->max;
+    }
+
+    return hist->max;
+}
+
+// --------------------------------------------------------------
+// Stress thread
+
+static bool
+queue_push(CommandQueue* queue, const Command* command)
+{
+    const unsigned head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    const unsigned tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+    if (head - tail == QUEUE_SIZE)
+        return false;
+
+    queue->commands[head % QUEUE_SIZE] = *command;
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return true;
+}
+
+static bool
+queue_pop(CommandQueue* queue, Command* command)
+{
+    const unsigned tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    const unsigned head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+    if (head == tail)
+        return false;
+
+    *command = queue->commands[tail % QUEUE_SIZE];
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+static const char* const units[] = { "VOLT", "Hz", "semitones", "%" };
+
+static LV2_URID unit_string_urid;
+static LV2_URID atom_String;
+static LV2_URID patch_Set;
+static LV2_URID patch_property;
+static LV2_URID patch_value;
+
+static const void*
+retrieve_unit(LV2_State_Handle handle, uint32_t key, size_t* size, uint32_t* type, uint32_t* flags)
+{
+    if (key != unit_string_urid)
+        return NULL;
+
+    const char* unit = units[*(const uint64_t*)handle % 4];
+    *size  = strlen(unit) + 1;
+    *type  = atom_String;
+    *flags = LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE;
+    return unit;
+}
+
+static void*
+stress_main(void* data)
+{
+    Stress*  stress = (Stress*)data;
+    uint64_t seen   = 0;
+
+    while (!atomic_load_explicit(&stress->stop, memory_order_relaxed)) {
+        const uint64_t blocks = atomic_load_explicit(&stress->blocks, memory_order_relaxed);
+        if (blocks == seen) {
+            sched_yield();
+            continue;
+        }
+        seen = blocks;
+
+        // a full queue drops the command, like a host dropping UI events
+        Command command = { COMMAND_KNOB, (rand() % 10001) * 0.001f };
+        queue_push(&stress->queue, &command);
+
+        if (seen % FLOOD_EVERY == 0) {
+            for (int i = 0; i < FLOOD_SETS; i++) {
+                command.type  = COMMAND_SET_UNIT;
+                command.value = (float)(i % 4);
+                queue_push(&stress->queue, &command);
+            }
+        }
+
+        atomic_store_explicit(&stress->queued, seen, memory_order_release);
+
+        if (stress->state && seen % RESTORE_EVERY == 0) {
+            stress->state->restore(stress->instance, retrieve_unit, &stress->restores, 0, NULL);
+            stress->restores++;
+        }
+    }
+
+    return NULL;
+}
+
+/** Write the commands queued since the last block to the control input of the plugin. */
+static void
+forge_commands(LV2_Atom_Forge* forge, uint8_t* buf, CommandQueue* queue, uint32_t block_size)
+{
+    lv2_atom_forge_set_buffer(forge, buf, IN_CAPACITY);
+
+    LV2_Atom_Forge_Frame seq_frame;
+    lv2_atom_forge_sequence_head(forge, &seq_frame, 0);
+
+    Command command;
+    for (uint32_t i = 0; i < EVENTS_PER_RUN && queue_pop(queue, &command); i++) {
+        const int64_t frames = (int64_t)(i * block_size / EVENTS_PER_RUN);
+        lv2_atom_forge_frame_time(forge, frames);
+
+        if (command.type == COMMAND_KNOB) {
+            lv2_atom_forge_float(forge, command.value);
+            continue;
+        }
+
+        const char* unit = units[(int)command.value];
+
+        LV2_Atom_Forge_Frame frame;
+        lv2_atom_forge_object(forge, &frame, 0, patch_Set);
+        lv2_atom_forge_key(forge, patch_property);
+        lv2_atom_forge_urid(forge, unit_string_urid);
+        lv2_atom_forge_key(forge, patch_value);
+        lv2_atom_forge_string(forge, unit, (uint32_t)strlen(unit));
+        lv2_atom_forge_pop(forge, &frame);
+    }
+
+    lv2_atom_forge_pop(forge, &seq_frame);
+}
+
+// --------------------------------------------------------------
+
+int
+main(int argc, char** argv)
+{
+    static const uint32_t hmi_delays_us[] = { 0, 20, 200 };
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s PLUGIN.so [BLOCKS] [BLOCK_SIZE]\n", argv[0]);
+        return 1;
+    }
+
+    const uint32_t n_blocks   = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 20000;
+    const uint32_t block_size = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 10) : 128;
+
+    if (block_size == 0 || block_size > MAX_BLOCK_SIZE) {
+        fprintf(stderr, "latency: block size must be 1 to %d\n", MAX_BLOCK_SIZE);
+        return 1;
+    }
+
+    host_name   = "latency";
+    host_timing = true;
+
+    FakeHost host;
+    if (!load_plugin(&host, argv[1]))
+        return 1;
+
+    const LV2_Descriptor* desc = host.desc;
+
+    // mapped up front, urid_map() is not thread safe
+    unit_string_urid = urid_map(NULL, UNIT_STRING_URI);
+    atom_String      = urid_map(NULL, LV2_ATOM__String);
+    patch_Set        = urid_map(NULL, LV2_PATCH__Set);
+    patch_property   = urid_map(NULL, LV2_PATCH__property);
+    patch_value      = urid_map(NULL, LV2_PATCH__value);
+
+    LV2_Atom_Forge forge;
+    lv2_atom_forge_init(&forge, &host.map);
+
+    static float controls[N_PORTS];
+    static float output[MAX_BLOCK_SIZE];
+    static uint64_t in_buf[IN_CAPACITY / sizeof(uint64_t)];
+    static uint64_t out_buf[OUT_CAPACITY / sizeof(uint64_t)];
+    static Stress stress;
+    static Histogram hists[COMPONENT_COUNT];
+
+    LV2_Atom_Sequence* out_seq = (LV2_Atom_Sequence*)out_buf;
+
+    printf("worker,hmi_delay_us,stress,component,blocks,p50_ns,p99_ns,p999_ns,max_ns\n");
+
+    for (size_t d = 0; d < sizeof(hmi_delays_us) / sizeof(hmi_delays_us[0]); d++) {
+        for (int use_worker = 0; use_worker <= (host.worker ? 1 : 0); use_worker++) {
+            for (int use_stress = 0; use_stress <= 1; use_stress++) {
+                hmi_delay_ns = hmi_delays_us[d] * 1000ULL;
+
+                const unsigned features = use_worker ? HOST_LOG | HOST_HMI | HOST_WORKER
+                                                     : HOST_LOG | HOST_HMI;
+                LV2_Handle instance = desc->instantiate(desc, SAMPLE_RATE, "",
+                                                        host_features(&host, features));
+                if (!instance) {
+                    fprintf(stderr, "latency: instantiate failed\n");
+                    return 1;
+                }
+
+                connect_all(desc, instance, controls, output, in_buf, out_seq);
+                controls[Knob] = 5.0f;
+
+                if (desc->activate)
+                    desc->activate(instance);
+
+                address_knob(&host, instance);
+
+                memset(hists, 0, sizeof(hists));
+                memset(&stress, 0, sizeof(stress));
+                stress.state    = host.state;
+                stress.instance = instance;
+                atomic_init(&stress.queue.head, 0);
+                atomic_init(&stress.queue.tail, 0);
+                atomic_init(&stress.blocks, 0);
+                atomic_init(&stress.queued, 0);
+                atomic_init(&stress.stop, false);
+
+                pthread_t thread;
+                if (use_stress && pthread_create(&thread, NULL, stress_main, &stress)) {
+                    fprintf(stderr, "latency: can not start the stress thread\n");
+                    return 1;
+                }
+
+                for (uint32_t b = 0; b < n_blocks; b++) {
+                    while (use_stress && atomic_load_explicit(&stress.queued, memory_order_acquire) < b)
+                        sched_yield();
+
+                    forge_commands(&forge, (uint8_t*)in_buf, &stress.queue, block_size);
+                    reset_output(out_seq, OUT_CAPACITY);
+
+                    host_ns = 0;
+                    const uint64_t start = host_now_ns();
+                    desc->run(instance, block_size);
+                    const uint64_t run_ns = host_now_ns() - start;
+
+                    hist_record(&hists[COMPONENT_RUN], run_ns);
+                    hist_record(&hists[COMPONENT_HOST], host_ns);
+                    hist_record(&hists[COMPONENT_DSP], run_ns > host_ns ? run_ns - host_ns : 0);
+
+                    if (work_requested) {
+                        const uint64_t work_start = host_now_ns();
+                        run_work(&host, instance);
+                        hist_record(&hists[COMPONENT_WORK], host_now_ns() - work_start);
+                    }
+
+                    atomic_store_explicit(&stress.blocks, b + 1, memory_order_relaxed);
+                }
+
+                if (use_stress) {
+                    atomic_store_explicit(&stress.stop, true, memory_order_relaxed);
+                    pthread_join(thread, NULL);
+                }
+
+                for (int c = 0; c < COMPONENT_COUNT; c++) {
+                    const Histogram* hist = &hists[c];
+                    if (!hist->count)
+                        continue;
+
+                    printf("%d,%u,%d,%s,%llu,%llu,%llu,%llu,%llu\n",
+                           use_worker, hmi_delays_us[d], use_stress, component_names[c],
+                           (unsigned long long)hist->count,
+                           (unsigned long long)hist_percentile(hist, 50.0),
+                           (unsigned long long)hist_percentile(hist, 99.0),
+                           (unsigned long long)hist_percentile(hist, 99.9),
+                           (unsigned long long)hist->max);
+                }
+                fflush(stdout);
+
+                if (host.notif)
+                    host.notif->unaddressed(instance, Knob);
+                if (desc->deactivate)
+                    desc->deactivate(instance);
+                desc->cleanup(instance);
+            }
+        }
+    }
+
+    unload_plugin(&host);
+
+    return 0;
+}
@@ -0,0 +1,192 @@
+/*
+  Control rate smoothing benchmark for mod-advanced-control-to-cv
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+  THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+   Times smoother_render() at audio rate and at control rate with linear
+   interpolation or hold, and measures how far the control rate output is
+   from the audio rate one.
+
+   The knob is automated the way a host does it, a new random level every
+   block of 128 samples.  Smoothing times are 0.29 ms, 10 ms and 100 ms, the
+   latter being the slow modulation control rate is meant for.
+
+   Results are printed to stdout as CSV, one line per case:
+   mode,time_ms,decimation,interpolation,ns_per_sample,max_error,rms_error
+   Errors are in knob units over the 0..10 range of the output.
+
+   Then every block is rendered in parts of 10, 5 and 113 samples, the way
+   run() splits a block at events, and compared with the whole blocks:
+   mode,time_ms,decimation,interpolation,split_max_diff
+   The difference should be no more than float rounding.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "smoothing.h"
+
+#define SAMPLE_RATE     48000.0
+#define BLOCK_SIZE      128
+#define N_BLOCKS        4096
+#define N_SAMPLES       (BLOCK_SIZE * N_BLOCKS)
+#define REPETITIONS     5
+
+static const char* const mode_names[SMOOTH_MODE_COUNT] = {
+    "off",
+    "one-pole",
+    "two-pole",
+    "linear",
+    "slew",
+};
+
+static double
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int
+cmp_double(const void* a, const void* b)
+{
+    const double da = *(const double*)a;
+    const double db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+/** Render all blocks, to consecutive blocks of out or with stride 0 all to the first. */
+static void
+render_all(SmoothMode mode, float time_ms, uint32_t decimation, bool hold,
+           const float* targets, float* out, uint32_t stride)
+{
+    Smoother s;
+    smoother_init(&s, SAMPLE_RATE, 10.0f, mode, time_ms, time_ms);
+    smoother_set_decimation(&s, decimation, hold);
+
+    for (uint32_t b = 0; b < N_BLOCKS; b++)
+        smoother_render(&s, targets[b], 1.0f, 0.0f, out + b * stride, BLOCK_SIZE);
+}
+
+/** Render all blocks to consecutive blocks of out, each in parts like a block split at events. */
+static void
+render_split(SmoothMode mode, float time_ms, uint32_t decimation, bool hold,
+             const float* targets, float* out)
+{
+    static const uint32_t parts[] = { 10, 5, BLOCK_SIZE - 15 };
+
+    Smoother s;
+    smoother_init(&s, SAMPLE_RATE, 10.0f, mode, time_ms, time_ms);
+    smoother_set_decimation(&s, decimation, hold);
+
+    for (uint32_t b = 0; b < N_BLOCKS; b++) {
+        float* block = out + b * BLOCK_SIZE;
+
+        for (size_t p = 0; p < sizeof(parts) / sizeof(parts[0]); p++) {
+            smoother_render(&s, targets[b], 1.0f, 0.0f, block, parts[p]);
+            block += parts[p];
+        }
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    static const float    times_ms[]    = { 0.29f, 10.0f, 100.0f };
+    static const uint32_t decimations[] = { 1, 16, 32 };
+
+    float* targets   = (float*)malloc(sizeof(float) * N_BLOCKS);
+    float* reference = (float*)malloc(sizeof(float) * N_SAMPLES);
+    float* out       = (float*)malloc(sizeof(float) * N_SAMPLES);
+    double sink      = 0.0;
+
+    srand(1);
+    for (uint32_t b = 0; b < N_BLOCKS; b++)
+        targets[b] = (rand() % 10001) * 0.001f;
+
+    printf("mode,time_ms,decimation,interpolation,ns_per_sample,max_error,rms_error\n");
+
+    for (int mode = SMOOTH_ONE_POLE; mode < SMOOTH_MODE_COUNT; mode++) {
+        for (size_t t = 0; t < sizeof(times_ms) / sizeof(times_ms[0]); t++) {
+            render_all((SmoothMode)mode, times_ms[t], 1, false, targets, reference, BLOCK_SIZE);
+
+            for (size_t d = 0; d < sizeof(decimations) / sizeof(decimations[0]); d++) {
+                for (int hold = 0; hold <= (decimations[d] > 1); hold++) {
+                    // timed into one block like a plugin output port, kept in cache
+                    double results[REPETITIONS];
+                    for (int r = 0; r < REPETITIONS; r++) {
+                        const double start = now_ns();
+                        render_all((SmoothMode)mode, times_ms[t], decimations[d], hold, targets, out, 0);
+                        results[r] = (now_ns() - start) / N_SAMPLES;
+                        sink += out[BLOCK_SIZE - 1];
+                    }
+                    qsort(results, REPETITIONS, sizeof(double), cmp_double);
+
+                    render_all((SmoothMode)mode, times_ms[t], decimations[d], hold, targets, out, BLOCK_SIZE);
+
+                    double max_error = 0.0;
+                    double sum_sq    = 0.0;
+                    for (uint32_t i = 0; i < N_SAMPLES; i++) {
+                        const double e = fabs((double)out[i] - (double)reference[i]);
+                        max_error = e > max_error ? e : max_error;
+                        sum_sq   += e * e;
+                    }
+
+                    printf("%s,%g,%u,%s,%.3f,%.3g,%.3g\n",
+                           mode_names[mode], times_ms[t], decimations[d],
+                           decimations[d] == 1 ? "none" : hold ? "hold" : "linear",
+                           results[REPETITIONS / 2], max_error, sqrt(sum_sq / N_SAMPLES));
+                    fflush(stdout);
+                }
+            }
+        }
+    }
+
+    printf("\nmode,time_ms,decimation,interpolation,split_max_diff\n");
+
+    for (int mode = SMOOTH_OFF; mode < SMOOTH_MODE_COUNT; mode++) {
+        for (size_t t = 0; t < sizeof(times_ms) / sizeof(times_ms[0]); t++) {
+            for (size_t d = 0; d < sizeof(decimations) / sizeof(decimations[0]); d++) {
+                for (int hold = 0; hold <= (decimations[d] > 1); hold++) {
+                    render_all((SmoothMode)mode, times_ms[t], decimations[d], hold, targets, reference, BLOCK_SIZE);
+                    render_split((SmoothMode)mode, times_ms[t], decimations[d], hold, targets, out);
+
+                    double max_diff = 0.0;
+                    for (uint32_t i = 0; i < N_SAMPLES; i++) {
+                        const double e = fabs((double)out[i] - (double)reference[i]);
+                        max_diff = e > max_diff ? e : max_diff;
+                    }
+
+                    printf("%s,%g,%u,%s,%.3g\n",
+                           mode_names[mode], times_ms[t], decimations[d],
+                           decimations[d] == 1 ? "none" : hold ? "hold" : "linear", max_diff);
+                }
+            }
+        }
+    }
+
+    free(targets);
+    free(reference);
+    free(out);
+
+    // keeps the renders from being optimised away
+    return sink == 0.0;
+}
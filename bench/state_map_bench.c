@@ -0,0 +1,148 @@
+/*
+  State map lookup benchmark for mod-advanced-control-to-cv
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+  THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+   Times state_map_find() against the sorted array and bsearch() lookup it
+   replaced, with 1, 16 and 128 properties.
+
+   Property URIDs are spread at random over the first 100000 URIDs, like a
+   host that has mapped many other URIs before the plugin was instantiated.
+   One in eight lookups is for a URID that is not a property.  Before timing,
+   every lookup is done by both methods and the results compared.
+
+   Results are printed to stdout as CSV, one line per case:
+   method,properties,lookups,max_probe,ns_per_lookup
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#define STATE_MAP_MAX_ITEMS 128
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "state_map.h"
+
+#define URID_RANGE      100000
+#define N_LOOKUPS       (1 << 16)
+#define REPETITIONS     64
+
+static double
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/** The lookup state_map.h used before, kept here as the reference. */
+static int
+legacy_cmp(const void* a, const void* b)
+{
+    const StateMapItem* ka = (const StateMapItem*)a;
+    const StateMapItem* kb = (const StateMapItem*)b;
+    return ka->urid < kb->urid ? -1 : kb->urid < ka->urid ? 1 : 0;
+}
+
+static StateMapItem*
+legacy_find(StateMapItem dict[], uint32_t n_entries, LV2_URID urid)
+{
+    StateMapItem key;
+    key.urid = urid;
+    return (StateMapItem*)bsearch(&key, dict, n_entries, sizeof(StateMapItem), legacy_cmp);
+}
+
+static bool
+is_property(const StateMapItem* items, uint32_t n, LV2_URID urid)
+{
+    for (uint32_t i = 0; i < n; i++) {
+        if (items[i].urid == urid)
+            return true;
+    }
+    return false;
+}
+
+int
+main(int argc, char** argv)
+{
+    static const uint32_t sizes[] = { 1, 16, 128 };
+
+    StateMapItem items[STATE_MAP_MAX_ITEMS];
+    StateMapItem sorted[STATE_MAP_MAX_ITEMS];
+    StateMap     index;
+    LV2_URID*    keys = (LV2_URID*)malloc(sizeof(LV2_URID) * N_LOOKUPS);
+    uintptr_t    sink = 0;
+
+    srand(1);
+
+    printf("method,properties,lookups,max_probe,ns_per_lookup\n");
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        const uint32_t n = sizes[s];
+
+        memset(items, 0, sizeof(items));
+        for (uint32_t i = 0; i < n; i++) {
+            LV2_URID urid;
+            do {
+                urid = 1 + (LV2_URID)(rand() % URID_RANGE);
+            } while (is_property(items, i, urid));
+            items[i].urid = urid;
+        }
+
+        state_map_index(&index, items, n);
+
+        memcpy(sorted, items, sizeof(items));
+        qsort(sorted, n, sizeof(StateMapItem), legacy_cmp);
+
+        for (uint32_t i = 0; i < N_LOOKUPS; i++) {
+            keys[i] = (rand() % 8) ? items[rand() % n].urid
+                                   : 1 + (LV2_URID)(rand() % URID_RANGE);
+        }
+
+        for (uint32_t i = 0; i < N_LOOKUPS; i++) {
+            const StateMapItem* ours = state_map_find(&index, keys[i]);
+            const StateMapItem* ref  = legacy_find(sorted, n, keys[i]);
+            if ((ours == NULL) != (ref == NULL) || (ours && ours->urid != ref->urid)) {
+                fprintf(stderr, "state_map_find(%u) differs from bsearch\n", keys[i]);
+                return 1;
+            }
+        }
+
+        double start = now_ns();
+        for (int r = 0; r < REPETITIONS; r++) {
+            for (uint32_t i = 0; i < N_LOOKUPS; i++)
+                sink += (uintptr_t)state_map_find(&index, keys[i]);
+        }
+        const double ours = (now_ns() - start) / ((double)REPETITIONS * N_LOOKUPS);
+
+        start = now_ns();
+        for (int r = 0; r < REPETITIONS; r++) {
+            for (uint32_t i = 0; i < N_LOOKUPS; i++)
+                sink += (uintptr_t)legacy_find(sorted, n, keys[i]);
+        }
+        const double ref = (now_ns() - start) / ((double)REPETITIONS * N_LOOKUPS);
+
+        printf("hash,%u,%u,%u,%.2f\n", n, REPETITIONS * N_LOOKUPS, index.max_probe, ours);
+        printf("bsearch,%u,%u,,%.2f\n", n, REPETITIONS * N_LOOKUPS, ref);
+    }
+
+    free(keys);
+
+    // keeps the lookups from being optimised away
+    return sink == 0;
+}
@@ -0,0 +1,426 @@
+/*
+  Control bank for mod-advanced-control-to-cv
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+  THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+   A bank of CV controls in a single plugin.
+
+   Every channel has its own Knob, Min, Max and Round port and CV output, the
+   smoothing is shared.  The channel state is kept as structure of arrays and
+   all outputs are rendered together by one_pole_bank_render(), so a bank costs
+   one run() call and one pass over the block instead of one plugin per
+   control.  Each Knob port is addressed to the HMI on its own.
+
+   Only the one-pole smoothing is offered: it is the only mode whose state is
+   a single distance per channel, which is what lets the channels share one
+   render loop.  The bank has no atom ports, the unit shown on the HMI is
+   always UNIT_STRING_TEXT.
+*/
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "control_bank.h"
+#include "denormals.h"
+#include "hmi_display.h"
+#include "hmi_ring.h"
+#include "smoothing.h"
+
+#include "lv2/core/lv2.h"
+#include "lv2/core/lv2_util.h"
+#include "lv2/log/log.h"
+#include "lv2/log/logger.h"
+#include "lv2/urid/urid.h"
+#include "lv2/worker/worker.h"
+
+#include "lv2-hmi.h"
+
+#define CHANNELS    CONTROL_BANK_CHANNELS
+
+typedef enum {
+    BANK_CV         = 0,
+    BANK_KNOB       = BANK_CV + CHANNELS,
+    BANK_MIN        = BANK_KNOB + CHANNELS,
+    BANK_MAX        = BANK_MIN + CHANNELS,
+    BANK_ROUND      = BANK_MAX + CHANNELS,
+    BANK_SMOOTHING  = BANK_ROUND + CHANNELS,
+    BANK_SMOOTH_TIME
+} BankPortIndex;
+
+typedef struct {
+    // Ports, one entry per channel
+    float*       output[CHANNELS];
+    const float* level[CHANNELS];
+    const float* min[CHANNELS];
+    const float* max[CHANNELS];
+    const float* round[CHANNELS];
+
+    // shared controls
+    const float* smooth;
+    const float* smooth_time;
+
+    // Smoothing, shared coefficients and the distance of each output to its target
+    double  rate;
+    float   time_ms;
+    OnePole one_pole;
+    float   target[CHANNELS];
+    double  dist[CHANNELS];
+
+    // Display state per channel
+    float   prev_value[CHANNELS];
+    float   prev_min[CHANNELS];
+    float   prev_max[CHANNELS];
+    int     prev_round[CHANNELS];
+    int64_t prev_key[CHANNELS];
+
+    // Features
+    LV2_URID_Map*          map;
+    LV2_Log_Logger         logger;
+    LV2_HMI_WidgetControl* hmi;
+    LV2_Worker_Schedule*   schedule;
+
+    // HMI Widgets stuff, per channel
+    LV2_HMI_Addressing control_addressing[CHANNELS];
+    float              control_min[CHANNELS];
+    float              control_max[CHANNELS];
+    int                control_steps[CHANNELS];
+
+    // Display updates handed to the worker
+    HmiRing hmi_ring;
+    bool    hmi_pending[CHANNELS];
+    bool    work_scheduled;
+} ControlBank;
+
+/** Knob port of a channel, limited to the knob range. */
+static float
+channel_knob(const ControlBank* self, uint32_t c)
+{
+    const float value = *self->level[c];
+    return value < KNOB_MIN ? KNOB_MIN : value > KNOB_MAX ? KNOB_MAX : value;
+}
+
+static float
+screen_level(const ControlBank* self, uint32_t c)
+{
+    return snap_to_steps(channel_knob(self, c),
+                         self->control_min[c], self->control_max[c], self->control_steps[c]);
+}
+
+static int64_t
+current_screen_key(const ControlBank* self, uint32_t c)
+{
+    return screen_value_key(screen_level(self, c), *self->min[c], *self->max[c], (int)*self->round[c] == 1);
+}
+
+static void
+update_screen_value(ControlBank* self, uint32_t c)
+{
+    char bfr[SCREEN_VALUE_SIZE];
+    format_screen_value(bfr, sizeof(bfr), screen_level(self, c),
+                        *self->min[c], *self->max[c], (int)*self->round[c] == 1);
+
+    self->hmi->set_value(self->hmi->handle, self->control_addressing[c], bfr);
+
+    self->prev_value[c] = channel_knob(self, c);
+    self->prev_min[c]   = *self->min[c];
+    self->prev_max[c]   = *self->max[c];
+    self->prev_round[c] = *self->round[c];
+    self->prev_key[c]   = current_screen_key(self, c);
+}
+
+/**
+   Hand pending display updates to the worker, see post_hmi_updates() of the
+   single control.  Channels that do not fit in the ring stay pending.
+*/
+static void
+post_hmi_updates(ControlBank* self)
+{
+    for (uint32_t c = 0; c < CHANNELS; c++) {
+        if (!self->hmi_pending[c])
+            continue;
+
+        HmiUpdate update;
+        update.type    = HMI_UPDATE_VALUE;
+        update.channel = c;
+        update.data.value.level = screen_level(self, c);
+        update.data.value.min   = *self->min[c];
+        update.data.value.max   = *self->max[c];
+        update.data.value.round = (int)*self->round[c] == 1;
+        update.data.value.text  = NULL;
+
+        if (!hmi_ring_push(&self->hmi_ring, &update))
+            break;
+
+        self->hmi_pending[c] = false;
+    }
+
+    if (!self->work_scheduled && !hmi_ring_empty(&self->hmi_ring)) {
+        const uint32_t token = 0;
+        if (self->schedule->schedule_work(self->schedule->handle, sizeof(token), &token) == LV2_WORKER_SUCCESS)
+            self->work_scheduled = true;
+    }
+}
+
+static LV2_Handle
+instantiate(const LV2_Descriptor*     descriptor,
+            double                    rate,
+            const char*               bundle_path,
+            const LV2_Feature* const* features)
+{
+    // the smoother holds vectors, which need more than malloc() aligns to
+    ControlBank* self = NULL;
+    if (posix_memalign((void**)&self, __alignof__(ControlBank), sizeof(ControlBank)))
+        return NULL;
+
+    memset(self, 0, sizeof(*self));
+
+    // Get host features
+    // clang-format off
+    lv2_features_query(
+            features,
+            LV2_LOG__log,           &self->logger.log,  false,
+            LV2_URID__map,          &self->map,         false,
+            LV2_HMI__WidgetControl, &self->hmi,         false,
+            LV2_WORKER__schedule,   &self->schedule,    false,
+            NULL);
+    // clang-format on
+
+    lv2_log_logger_set_map(&self->logger, self->map);
+
+    self->rate    = rate;
+    self->time_ms = SMOOTH_TIME_DEFAULT;
+    one_pole_set_time(&self->one_pole, self->time_ms * 0.001 * rate);
+
+    for (uint32_t c = 0; c < CHANNELS; c++)
+        self->prev_key[c] = INT64_MIN;
+
+    hmi_ring_init(&self->hmi_ring);
+
+    return (LV2_Handle)self;
+}
+
+static void
+connect_port(LV2_Handle instance, uint32_t port, void* data)
+{
+    ControlBank* self = (ControlBank*)instance;
+
+    if (port < BANK_KNOB)
+        self->output[port - BANK_CV] = (float*)data;
+    else if (port < BANK_MIN)
+        self->level[port - BANK_KNOB] = (const float*)data;
+    else if (port < BANK_MAX)
+        self->min[port - BANK_MIN] = (const float*)data;
+    else if (port < BANK_ROUND)
+        self->max[port - BANK_MAX] = (const float*)data;
+    else if (port < BANK_SMOOTHING)
+        self->round[port - BANK_ROUND] = (const float*)data;
+    else if (port == BANK_SMOOTHING)
+        self->smooth = (const float*)data;
+    else if (port == BANK_SMOOTH_TIME)
+        self->smooth_time = (const float*)data;
+}
+
+static void
+activate(LV2_Handle instance)
+{
+}
+
+static void
+run(LV2_Handle instance, uint32_t n_samples)
+{
+    ControlBank* self = (ControlBank*)instance;
+
+    // subnormals would only come from a filter tail, flush them while we run
+    const DenormalState fp_state = denormals_disable();
+
+    if (*self->smooth_time != self->time_ms) {
+        self->time_ms = *self->smooth_time;
+        one_pole_set_time(&self->one_pole, self->time_ms * 0.001 * self->rate);
+    }
+
+    const bool smoothing = *self->smooth > 0.5f;
+
+    for (uint32_t c = 0; c < CHANNELS; c++) {
+        const float knob = channel_knob(self, c);
+
+        // a new target keeps the output where it is, without smoothing it jumps
+        self->dist[c]   = smoothing ? self->dist[c] + (self->target[c] - knob) : 0.0;
+        self->target[c] = knob;
+    }
+
+    if (n_samples)
+        one_pole_bank_render(&self->one_pole, self->target, self->dist, self->output, CHANNELS, n_samples);
+
+    //update screen values, only if the displayed text changes
+    for (uint32_t c = 0; c < CHANNELS; c++) {
+        if ((self->target[c] == self->prev_value[c]) &&
+            (*self->min[c] == self->prev_min[c]) &&
+            (*self->max[c] == self->prev_max[c]) &&
+            (*self->round[c] == self->prev_round[c]))
+            continue;
+
+        self->prev_value[c] = self->target[c];
+        self->prev_min[c]   = *self->min[c];
+        self->prev_max[c]   = *self->max[c];
+        self->prev_round[c] = *self->round[c];
+
+        const int64_t key = current_screen_key(self, c);
+
+        if (key != self->prev_key[c] && self->hmi && self->control_addressing[c]) {
+            self->prev_key[c] = key;
+
+            if (self->schedule)
+                self->hmi_pending[c] = true;
+            else
+                update_screen_value(self, c);
+        }
+    }
+
+    if (self->schedule)
+        post_hmi_updates(self);
+
+    denormals_restore(fp_state);
+}
+
+static void
+deactivate(LV2_Handle instance)
+{
+}
+
+static void
+cleanup(LV2_Handle instance)
+{
+    free(instance);
+}
+
+/** Worker side of the display updates, the newest value of each channel is sent. */
+static LV2_Worker_Status
+work(LV2_Handle                  instance,
+     LV2_Worker_Respond_Function respond,
+     LV2_Worker_Respond_Handle   handle,
+     uint32_t                    size,
+     const void*                 data)
+{
+    ControlBank* self = (ControlBank*)instance;
+
+    HmiUpdate latest[CHANNELS];
+    bool      has_update[CHANNELS] = { false };
+    HmiUpdate update;
+
+    while (hmi_ring_pop(&self->hmi_ring, &update)) {
+        if (update.type != HMI_UPDATE_VALUE || update.channel >= CHANNELS)
+            continue;
+
+        latest[update.channel] = update;
+        has_update[update.channel] = true;
+    }
+
+    for (uint32_t c = 0; c < CHANNELS; c++) {
+        const LV2_HMI_Addressing addressing = self->control_addressing[c];
+
+        if (!has_update[c] || !self->hmi || !addressing)
+            continue;
+
+        char bfr[SCREEN_VALUE_SIZE];
+        format_screen_value(bfr, sizeof(bfr),
+                            latest[c].data.value.level,
+                            latest[c].data.value.min,
+                            latest[c].data.value.max,
+                            latest[c].data.value.round);
+        self->hmi->set_value(self->hmi->handle, addressing, bfr);
+    }
+
+    const uint32_t token = 0;
+    return respond(handle, sizeof(token), &token);
+}
+
+static LV2_Worker_Status
+work_response(LV2_Handle instance, uint32_t size, const void* data)
+{
+    ControlBank* self = (ControlBank*)instance;
+
+    self->work_scheduled = false;
+
+    return LV2_WORKER_SUCCESS;
+}
+
+static void
+addressed(LV2_Handle handle, uint32_t index, LV2_HMI_Addressing addressing, const LV2_HMI_AddressingInfo* info)
+{
+    ControlBank* self = (ControlBank*)handle;
+
+    // nothing to show without the widget feature
+    if (!self->hmi || index < BANK_KNOB || index >= BANK_KNOB + CHANNELS)
+        return;
+
+    const uint32_t c = index - BANK_KNOB;
+
+    self->control_addressing[c] = addressing;
+
+    if (info) {
+        self->control_min[c]   = info->min;
+        self->control_max[c]   = info->max;
+        self->control_steps[c] = info->steps;
+    }
+
+    update_screen_value(self, c);
+
+    self->hmi->set_unit(self->hmi->handle, addressing, UNIT_STRING_TEXT);
+}
+
+static void
+unaddressed(LV2_Handle handle, uint32_t index)
+{
+    ControlBank* self = (ControlBank*)handle;
+
+    if (index < BANK_KNOB || index >= BANK_KNOB + CHANNELS)
+        return;
+
+    const uint32_t c = index - BANK_KNOB;
+
+    self->control_addressing[c] = NULL;
+    self->control_steps[c] = 0;
+}
+
+static const void*
+extension_data(const char* uri)
+{
+    static const LV2_HMI_PluginNotification hmiNotif = {
+        addressed,
+        unaddressed,
+    };
+    if (!strcmp(uri, LV2_HMI__PluginNotification))
+        return &hmiNotif;
+
+    static const LV2_Worker_Interface worker = {work, work_response, NULL};
+    if (!strcmp(uri, LV2_WORKER__interface)) {
+        return &worker;
+    }
+
+    return NULL;
+}
+
+const LV2_Descriptor control_bank_descriptor = {
+    CONTROL_BANK_URI,
+    instantiate,
+    connect_port,
+    activate,
+    run,
+    deactivate,
+    cleanup,
+    extension_data
+};
@@ -0,0 +1,32 @@
+/*
+  Control bank for mod-advanced-control-to-cv
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+  THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#ifndef CONTROL_BANK_H_INCLUDED
+#define CONTROL_BANK_H_INCLUDED
+
+#include "lv2/core/lv2.h"
+
+#define CONTROL_BANK_URI        "http://moddevices.com/plugins/mod-devel/mod-advanced-control-to-cv-bank"
+
+#define CONTROL_BANK_CHANNELS   8
+
+/**
+   Eight controls in one plugin, returned as the second descriptor of the
+   binary.  Saves the per-instance overhead of running a separate plugin for
+   every CV control of a pedalboard.
+*/
+extern const LV2_Descriptor control_bank_descriptor;
+
+#endif /* CONTROL_BANK_H_INCLUDED */
@@ -0,0 +1,129 @@
+/*
+  Transfer curve for mod-advanced-control-to-cv
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+  THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+   A knob response drawn as x/y breakpoints, both from 0 to 1, with straight
+   lines between them and flat before the first and after the last.
+
+   The breakpoints are compiled into a table of the curve at evenly spaced
+   positions, so the output is one interpolated table read per sample
+   instead of a search for the segment.  The table is exact at its entries,
+   and only differs from the breakpoint lines within the entry a breakpoint
+   falls in.
+*/
+
+#ifndef CURVE_H_INCLUDED
+#define CURVE_H_INCLUDED
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/** Breakpoints a curve can have. */
+#define CURVE_MAX_POINTS    32
+
+/** Segments of the table, it has one entry more for the end. */
+#define CURVE_TABLE_SIZE    1024
+
+typedef struct {
+    bool  linear;   // no breakpoints, the level passes unchanged
+    float y[CURVE_TABLE_SIZE + 1];
+} CurveTable;
+
+/**
+   Whether n_points x/y pairs make a curve, none is the linear response.
+   The range is checked on the bit pattern, which also refuses NaN since
+   the plugin is built with -ffast-math: from 0 up to 1 are the bit patterns
+   up to the one of 1.
+*/
+static inline bool
+curve_points_valid(const float* points, uint32_t n_points)
+{
+    if (n_points == 1 || n_points > CURVE_MAX_POINTS)
+        return false;
+
+    for (uint32_t i = 0; i < 2 * n_points; i++) {
+        uint32_t bits;
+        memcpy(&bits, &points[i], sizeof(bits));
+
+        if (bits > 0x3f800000u)
+            return false;
+    }
+
+    return true;
+}
+
+/** Fill the table from valid breakpoints in any order, not realtime safe. */
+static void
+curve_compile(CurveTable* curve, const float* points, uint32_t n_points)
+{
+    curve->linear = n_points == 0;
+    if (curve->linear)
+        return;
+
+    // sorted by x, insertion sort keeps points with the same x in order
+    float x[CURVE_MAX_POINTS];
+    float y[CURVE_MAX_POINTS];
+
+    for (uint32_t i = 0; i < n_points; i++) {
+        uint32_t j = i;
+        for (; j > 0 && x[j - 1] > points[2 * i]; j--) {
+            x[j] = x[j - 1];
+            y[j] = y[j - 1];
+        }
+        x[j] = points[2 * i];
+        y[j] = points[2 * i + 1];
+    }
+
+    uint32_t segment = 0;
+    for (uint32_t i = 0; i <= CURVE_TABLE_SIZE; i++) {
+        const float position = (float)i / (float)CURVE_TABLE_SIZE;
+
+        while (segment + 1 < n_points && x[segment + 1] <= position)
+            segment++;
+
+        if (position <= x[0])
+            curve->y[i] = y[0];
+        else if (segment + 1 == n_points)
+            curve->y[i] = y[n_points - 1];
+        else {
+            const float t = (position - x[segment]) / (x[segment + 1] - x[segment]);
+            curve->y[i] = y[segment] + (y[segment + 1] - y[segment]) * t;
+        }
+    }
+}
+
+/**
+   Shape n_samples of levels from 0 to range in place, one interpolated
+   read each and no branches.
+*/
+static inline void
+curve_render(const CurveTable* curve, float* level, uint32_t n_samples, float range)
+{
+    const float to_index = (float)CURVE_TABLE_SIZE / range;
+
+    for (uint32_t i = 0; i < n_samples; i++) {
+        const float x     = fminf(fmaxf(level[i] * to_index, 0.0f), (float)CURVE_TABLE_SIZE);
+        const int   cell  = (int)x;
+        const int   index = cell < CURVE_TABLE_SIZE - 1 ? cell : CURVE_TABLE_SIZE - 1;
+        const float y0    = curve->y[index];
+        const float y1    = curve->y[index + 1];
+
+        level[i] = (y0 + (y1 - y0) * (x - (float)index)) * range;
+    }
+}
+
+#endif /* CURVE_H_INCLUDED */
@@ -0,0 +1,74 @@
+/*
+  Denormal handling for mod-advanced-control-to-cv
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+  THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+   Flush-to-zero and denormals-are-zero for the duration of run().
+
+   The floating point control register belongs to the host thread, so the
+   previous mode is handed back by denormals_disable() and has to be put back
+   with denormals_restore() before run() returns.  On targets without such a
+   mode both are no-ops.
+*/
+
+#ifndef DENORMALS_H_INCLUDED
+#define DENORMALS_H_INCLUDED
+
+#include <stdint.h>
+
+#if defined(__SSE__) || defined(__x86_64__)
+#include <xmmintrin.h>
+#endif
+
+typedef uint64_t DenormalState;
+
+static inline DenormalState
+denormals_disable(void)
+{
+#if defined(__SSE__) || defined(__x86_64__)
+    const unsigned int csr = _mm_getcsr();
+    // FTZ is bit 15, DAZ bit 6
+    _mm_setcsr(csr | 0x8040);
+    return csr;
+#elif defined(__aarch64__)
+    uint64_t fpcr;
+    __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+    // FZ is bit 24
+    __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr | (1ULL << 24)));
+    return fpcr;
+#elif defined(__arm__) && defined(__ARM_FP)
+    uint32_t fpscr;
+    __asm__ __volatile__("vmrs %0, fpscr" : "=r"(fpscr));
+    __asm__ __volatile__("vmsr fpscr, %0" : : "r"(fpscr | (1U << 24)));
+    return fpscr;
+#else
+    return 0;
+#endif
+}
+
+static inline void
+denormals_restore(DenormalState state)
+{
+#if defined(__SSE__) || defined(__x86_64__)
+    _mm_setcsr((unsigned int)state);
+#elif defined(__aarch64__)
+    __asm__ __volatile__("msr fpcr, %0" : : "r"(state));
+#elif defined(__arm__) && defined(__ARM_FP)
+    __asm__ __volatile__("vmsr fpscr, %0" : : "r"((uint32_t)state));
+#else
+    (void)state;
+#endif
+}
+
+#endif /* DENORMALS_H_INCLUDED */
@@ -0,0 +1,132 @@
+/*
+  HMI display helpers for mod-advanced-control-to-cv
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+  THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+   How a knob level is shown on the MOD HMI, shared by the single control and
+   the control bank.  The knob range is mapped onto the Min/Max range and
+   formatted with the precision the Dwarf uses for that magnitude.
+*/
+
+#ifndef HMI_DISPLAY_H_INCLUDED
+#define HMI_DISPLAY_H_INCLUDED
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "num_format.h"
+
+#define SCREEN_VALUE_SIZE       16
+
+#define UNIT_STRING_TEXT        "VOLT"
+
+#define KNOB_MIN                0.0f
+#define KNOB_MAX                10.0f
+
+static inline float
+MAP(float x, float Imin, float Imax, float Omin, float Omax)
+{
+    return (( x - Imin ) * (Omax -  Omin)  / (Imax - Imin) + Omin);
+}
+
+//MOD products only support ascii 32 to 126
+static inline void
+check_string(char *text)
+{
+    int char_lenght = strlen(text);
+    int ascii = 0;
+    for (int i = 0; i < char_lenght; i++) {
+        ascii = (int)text[i];
+
+        //replace chars with -
+        if (ascii < 32)
+            text[i] = '-';
+
+        //dont do quotation marks as they are tricky
+        if (ascii == 34)
+            text[i] = '-';
+
+        if (ascii > 126)
+            text[i] = '-';
+    }
+}
+
+static inline void
+format_screen_value(char *bfr, uint32_t size, float level, float min, float max, bool round)
+{
+    if (round){
+        float minRound = roundf(min);
+        float maxRound = roundf(max);
+        int screen_value = roundf(MAP(level, 0, 10, minRound, maxRound));
+        format_int(screen_value, bfr, size);
+    }
+    else {
+        float screen_value = MAP(level, 0, 10, min, max);
+
+        //mimic MOD Dwarf HMI behaviour
+        if ((screen_value > 99.99) || (screen_value < -99.99))
+            format_fixed(screen_value, 1, bfr, size);
+        else if ((screen_value > 9.99) || (screen_value < -9.99))
+            format_fixed(screen_value, 2, bfr, size);
+        else
+            format_fixed(screen_value, 3, bfr, size);
+    }
+}
+
+/**
+   Integer key of the text format_screen_value() produces, using the same
+   precision rules.  Inputs with the same key show the same text.
+*/
+static inline int64_t
+screen_value_key(float level, float min, float max, bool round)
+{
+    if (round) {
+        float minRound = roundf(min);
+        float maxRound = roundf(max);
+        return (int64_t)(int)roundf(MAP(level, 0, 10, minRound, maxRound)) * 8;
+    }
+
+    float screen_value = MAP(level, 0, 10, min, max);
+    int precision;
+
+    if ((screen_value > 99.99) || (screen_value < -99.99))
+        precision = 1;
+    else if ((screen_value > 9.99) || (screen_value < -9.99))
+        precision = 2;
+    else
+        precision = 3;
+
+    // rounds like format_fixed(), the sign keeps "-0.000" apart from "0.000"
+    const double scaled = rint((double)screen_value * (double)num_format_pow10[precision]);
+
+    return (int64_t)scaled * 8 + (signbit(screen_value) ? 4 : 0) + precision;
+}
+
+/**
+   Snap a knob level to the hardware steps of an addressing.
+   The actuator can not show positions in between, so neither do we.
+*/
+static inline float
+snap_to_steps(float level, float min, float max, int steps)
+{
+    if (steps < 2 || !(max > min))
+        return level;
+
+    const float step = (max - min) / (steps - 1);
+    return min + roundf((level - min) / step) * step;
+}
+
+#endif /* HMI_DISPLAY_H_INCLUDED */
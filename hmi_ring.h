@@ -0,0 +1,114 @@
+/*
+  HMI update ring for mod-advanced-control-to-cv
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+  THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#ifndef HMI_RING_H_INCLUDED
+#define HMI_RING_H_INCLUDED
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hmi_value_table.h"
+
+/** Must be a power of two. */
+#define HMI_RING_SIZE   8
+
+/** The display unit field is short, longer unit strings are truncated. */
+#define HMI_UNIT_SIZE   64
+
+typedef enum {
+    HMI_UPDATE_VALUE = 0,
+    HMI_UPDATE_UNIT,
+    HMI_UPDATE_TABLE,
+    HMI_UPDATE_COUNT
+} HmiUpdateType;
+
+/**
+   A display update as posted by run().
+   Values are posted raw, formatting happens on the consumer side unless
+   text points to the preformatted value in a table.  A table update asks
+   for the table of a new range or addressing.  The channel selects the
+   addressed control of a multi-channel plugin.
+*/
+typedef struct {
+    HmiUpdateType type;
+    uint32_t      channel;
+    union {
+        struct {
+            float level;
+            float min;
+            float max;
+            bool  round;
+            const char* text;
+        } value;
+        char        unit[HMI_UNIT_SIZE];
+        HmiTableKey table;
+    } data;
+} HmiUpdate;
+
+/**
+   Lock-free single-producer/single-consumer ring.
+   The audio thread is the only producer, the worker the only consumer.
+*/
+typedef struct {
+    HmiUpdate    items[HMI_RING_SIZE];
+    atomic_uint  head;
+    atomic_uint  tail;
+} HmiRing;
+
+static inline void
+hmi_ring_init(HmiRing* ring)
+{
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+}
+
+/** Returns false, without blocking, if the ring is full. */
+static inline bool
+hmi_ring_push(HmiRing* ring, const HmiUpdate* update)
+{
+    const unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    const unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head - tail == HMI_RING_SIZE)
+        return false;
+
+    ring->items[head & (HMI_RING_SIZE - 1)] = *update;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
+
+static inline bool
+hmi_ring_pop(HmiRing* ring, HmiUpdate* update)
+{
+    const unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    const unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (head == tail)
+        return false;
+
+    *update = ring->items[tail & (HMI_RING_SIZE - 1)];
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+static inline bool
+hmi_ring_empty(HmiRing* ring)
+{
+    return atomic_load_explicit(&ring->head, memory_order_acquire) ==
+           atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
+
+#endif /* HMI_RING_H_INCLUDED */
@@ -0,0 +1,101 @@
+/*
+  Preformatted HMI values for mod-advanced-control-to-cv
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+  THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+   The display text of every hardware step of an addressing, formatted
+   ahead for one Min/Max/Round setting.
+
+   An addressed knob can only stand on its steps, 201 on the Dwarf, so the
+   text and the key screen_value_key() gives for each of them are known as
+   soon as the addressing and the range are.  A table is built outside the
+   audio thread, a display update is then a step index and a lookup.
+*/
+
+#ifndef HMI_VALUE_TABLE_H_INCLUDED
+#define HMI_VALUE_TABLE_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hmi_display.h"
+
+/** Addressings with more steps are formatted per update instead. */
+#define HMI_TABLE_MAX_STEPS     256
+
+/** What a table is formatted for, the range and the addressing. */
+typedef struct {
+    float min;
+    float max;
+    bool  round;
+    float control_min;
+    float control_max;
+    int   steps;
+} HmiTableKey;
+
+typedef struct {
+    HmiTableKey key;
+    bool        valid;
+    int64_t     screen_key[HMI_TABLE_MAX_STEPS];
+    char        text[HMI_TABLE_MAX_STEPS][SCREEN_VALUE_SIZE];
+} HmiValueTable;
+
+static inline bool
+hmi_table_key_equal(const HmiTableKey* a, const HmiTableKey* b)
+{
+    return a->min == b->min && a->max == b->max && a->round == b->round &&
+           a->control_min == b->control_min && a->control_max == b->control_max &&
+           a->steps == b->steps;
+}
+
+/** Whether an addressing can have a table at all. */
+static inline bool
+hmi_table_supported(const HmiTableKey* key)
+{
+    return key->steps >= 2 && key->steps <= HMI_TABLE_MAX_STEPS && key->control_max > key->control_min;
+}
+
+/** Format every step, not realtime safe. */
+static inline void
+hmi_table_build(HmiValueTable* table, const HmiTableKey* key)
+{
+    table->key   = *key;
+    table->valid = hmi_table_supported(key);
+
+    if (!table->valid)
+        return;
+
+    // the levels snap_to_steps() gives
+    const float step = (key->control_max - key->control_min) / (key->steps - 1);
+
+    for (int i = 0; i < key->steps; i++) {
+        const float level = key->control_min + (float)i * step;
+
+        format_screen_value(table->text[i], SCREEN_VALUE_SIZE, level, key->min, key->max, key->round);
+        table->screen_key[i] = screen_value_key(level, key->min, key->max, key->round);
+    }
+}
+
+/** Step of a knob level, the index of its text. */
+static inline int
+hmi_table_step(const HmiValueTable* table, float level)
+{
+    const HmiTableKey* key  = &table->key;
+    const float        step = (key->control_max - key->control_min) / (key->steps - 1);
+    const int          i    = (int)roundf((level - key->control_min) / step);
+
+    return i < 0 ? 0 : i >= key->steps ? key->steps - 1 : i;
+}
+
+#endif /* HMI_VALUE_TABLE_H_INCLUDED */
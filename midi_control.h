@@ -0,0 +1,173 @@
+/*
+  MIDI controller input for mod-advanced-control-to-cv
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+  THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+   Turns MIDI control changes into controller values from 0 to 1.
+
+   Controllers 0 to 31 are 14 bit once their LSB (controller + 32) has been
+   seen, until then the MSB alone is a 7 bit value.  An LSB refines the last
+   MSB.  NRPN data entry works the same way, for the parameter selected with
+   controllers 99 and 98.  While an RPN is selected, with controllers 101 and
+   100, data entry is ignored; the null RPN 127/127 selects nothing, which
+   makes controllers 6 and 38 plain controllers again.  Data increment and
+   decrement and the channel mode messages are ignored as well.
+
+   Messages of all channels are read into a single state, the input is omni.
+*/
+
+#ifndef MIDI_CONTROL_H_INCLUDED
+#define MIDI_CONTROL_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lv2/midi/midi.h"
+
+/** Controller or NRPN number of no source. */
+#define MIDI_CONTROL_NONE   (-1)
+
+#define MIDI_CONTROL_14BIT  32
+
+typedef enum {
+    MIDI_SOURCE_CC = 0,
+    MIDI_SOURCE_NRPN
+} MidiSource;
+
+typedef enum {
+    MIDI_PARAM_NONE = 0,
+    MIDI_PARAM_NRPN,
+    MIDI_PARAM_RPN
+} MidiParam;
+
+typedef struct {
+    MidiSource source;
+    int32_t    number;
+    float      value;
+} MidiControlValue;
+
+typedef struct {
+    uint8_t   msb[MIDI_CONTROL_14BIT];
+    bool      fine[MIDI_CONTROL_14BIT];
+
+    // selected parameter, the data entry applies to an NRPN only
+    MidiParam param;
+    uint8_t   param_msb;
+    uint8_t   param_lsb;
+    uint8_t   data_msb;
+    bool      data_fine;
+} MidiControl;
+
+static inline void
+midi_control_init(MidiControl* mc)
+{
+    memset(mc, 0, sizeof(*mc));
+}
+
+static inline float
+midi_control_coarse(uint8_t msb, bool fine)
+{
+    return fine ? (float)(msb << 7) * (1.0f / 16383.0f) : (float)msb * (1.0f / 127.0f);
+}
+
+static inline float
+midi_control_fine(uint8_t msb, uint8_t lsb)
+{
+    return (float)((msb << 7) | lsb) * (1.0f / 16383.0f);
+}
+
+/**
+   Read a MIDI message.  Returns true and fills out when it sets the value
+   of a controller or NRPN.
+*/
+static inline bool
+midi_control_read(MidiControl* mc, const uint8_t* msg, uint32_t size, MidiControlValue* out)
+{
+    if (size < 3 || lv2_midi_message_type(msg) != LV2_MIDI_MSG_CONTROLLER)
+        return false;
+
+    const uint8_t cc    = msg[1] & 0x7F;
+    const uint8_t value = msg[2] & 0x7F;
+
+    switch (cc) {
+        case LV2_MIDI_CTL_NRPN_MSB:
+        case LV2_MIDI_CTL_NRPN_LSB:
+        case LV2_MIDI_CTL_RPN_MSB:
+        case LV2_MIDI_CTL_RPN_LSB:
+            if (cc == LV2_MIDI_CTL_NRPN_MSB || cc == LV2_MIDI_CTL_RPN_MSB)
+                mc->param_msb = value;
+            else
+                mc->param_lsb = value;
+
+            if (cc == LV2_MIDI_CTL_NRPN_MSB || cc == LV2_MIDI_CTL_NRPN_LSB)
+                mc->param = MIDI_PARAM_NRPN;
+            else if (mc->param_msb == 127 && mc->param_lsb == 127)
+                mc->param = MIDI_PARAM_NONE;
+            else
+                mc->param = MIDI_PARAM_RPN;
+
+            mc->data_fine = false;
+            return false;
+
+        case LV2_MIDI_CTL_MSB_DATA_ENTRY:
+        case LV2_MIDI_CTL_LSB_DATA_ENTRY:
+            if (mc->param == MIDI_PARAM_RPN)
+                return false;
+            if (mc->param == MIDI_PARAM_NONE)
+                break;
+
+            out->source = MIDI_SOURCE_NRPN;
+            out->number = (mc->param_msb << 7) | mc->param_lsb;
+
+            if (cc == LV2_MIDI_CTL_MSB_DATA_ENTRY) {
+                mc->data_msb = value;
+                out->value   = midi_control_coarse(value, mc->data_fine);
+            }
+            else {
+                mc->data_fine = true;
+                out->value    = midi_control_fine(mc->data_msb, value);
+            }
+            return true;
+
+        default:
+            break;
+    }
+
+    // data increment and decrement, the (N)RPN selection and channel mode
+    if ((cc >= 96 && cc <= 101) || cc >= 120)
+        return false;
+
+    out->source = MIDI_SOURCE_CC;
+
+    if (cc < MIDI_CONTROL_14BIT) {
+        mc->msb[cc] = value;
+        out->number = cc;
+        out->value  = midi_control_coarse(value, mc->fine[cc]);
+    }
+    else if (cc < 2 * MIDI_CONTROL_14BIT) {
+        const uint8_t msb_cc = cc - MIDI_CONTROL_14BIT;
+        mc->fine[msb_cc] = true;
+        out->number = msb_cc;
+        out->value  = midi_control_fine(mc->msb[msb_cc], value);
+    }
+    else {
+        out->number = cc;
+        out->value  = (float)value * (1.0f / 127.0f);
+    }
+
+    return true;
+}
+
+#endif /* MIDI_CONTROL_H_INCLUDED */
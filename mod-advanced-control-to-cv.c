@@ -23,7 +23,19 @@
 #include <stdio.h>
 #include <stdatomic.h>
 
+#include "control_bank.h"
+#include "curve.h"
+#include "denormals.h"
+#include "hmi_display.h"
+#include "hmi_ring.h"
+#include "midi_control.h"
+#include "modulation.h"
+#include "perf_counters.h"
+#include "quantizer.h"
+#include "scope.h"
+#include "smoothing.h"
 #include "state_map.h"
+#include "unit_pool.h"
 
 #include "lv2/atom/atom.h"
 #include "lv2/atom/forge.h"
@@ -36,6 +48,7 @@
 #include "lv2/patch/patch.h"
 #include "lv2/state/state.h"
 #include "lv2/urid/urid.h"
+#include "lv2/worker/worker.h"
 
 #include <stdbool.h>
 #include <stdint.h>
@@ -47,14 +60,54 @@
 
 #define PLUGIN_URI "http://moddevices.com/plugins/mod-devel/mod-advanced-control-to-cv"
 
-#define N_PROPS             1
+#define N_PROPS             4
 #define MAX_STRING          1024
 
+// state_map_init() ignores the properties beyond what the map holds
+_Static_assert(N_PROPS <= STATE_MAP_MAX_ITEMS, "more properties than the state map holds");
+
+// bytes of property notifications forged per block, enough for any property
+#define NOTIFY_BUDGET       (2 * MAX_STRING)
+
+// upper bound of a patch:Set in a sequence without its value body
+#define NOTIFY_OVERHEAD     80
+
+// a Float event in a sequence, the frame time, atom header and padded body
+#define VALUE_EVENT_SIZE    24
+
+// tries of other threads to take the unit run() shows before the default
+#define UNIT_SHOWN_TRIES    8
+
+// a patch:Set with a full vector of scope points
+#define SCOPE_BUDGET        (NOTIFY_OVERHEAD + sizeof(LV2_Atom_Vector_Body) + SCOPE_MAX_POINTS * sizeof(ScopePoint))
+
 #define UNIT_STRING_URI         PLUGIN_URI "#unitstring"
+#define KNOB_URI                PLUGIN_URI "#knob"
+#define MIDI_CC_URI             PLUGIN_URI "#midiCC"
+#define MIDI_NRPN_URI           PLUGIN_URI "#midiNRPN"
+#define MIDI_LEARN_URI          PLUGIN_URI "#midiLearn"
+#define CURVE_URI               PLUGIN_URI "#curve"
+#define OUTPUT_URI              PLUGIN_URI "#output"
+#define SCOPE_URI               PLUGIN_URI "#scope"
+#define PERF_URI                PLUGIN_URI "#perf"
 
 #define SPECIAL_PORT_RESET      UINT8_MAX
 
-#define UNIT_STRING_TEXT        "VOLT"
+// set in state_middle while it holds a restored state run() has not taken
+#define STATE_FRESH             4u
+
+// samples per step while the output range glides to new Min/Max values, and
+// per chunk of modulated output
+#define RANGE_CHUNK             64
+
+// the hot part of an instance starts on one, the cold part on the next free one
+#define CACHE_LINE              64
+
+// what a scheduled work is for, the first word of its data
+typedef enum {
+    WORK_HMI = 0,
+    WORK_CURVE
+} WorkType;
 
 typedef struct {
     LV2_URID plugin;
@@ -63,7 +116,10 @@ typedef struct {
     LV2_URID atom_URID;
     LV2_URID atom_eventTransfer;
     LV2_URID atom_String;
+    LV2_URID atom_Bool;
     LV2_URID atom_Int;
+    LV2_URID atom_Float;
+    LV2_URID atom_Vector;
     LV2_URID midi_Event;
     LV2_URID patch_Get;
     LV2_URID patch_Set;
@@ -74,13 +130,58 @@ typedef struct {
     LV2_URID patch_value;
     LV2_URID state_StateChanged;
     LV2_URID unit_string;
+    LV2_URID knob;
+    LV2_URID midi_cc;
+    LV2_URID midi_nrpn;
+    LV2_URID midi_learn;
+    LV2_URID curve;
+    LV2_URID output;
+    LV2_URID scope;
+#ifdef PERF_COUNTERS
+    LV2_URID atom_Long;
+    LV2_URID atom_Double;
+    LV2_URID perf;
+    LV2_URID perf_runCalls;
+    LV2_URID perf_samples;
+    LV2_URID perf_cyclesMin;
+    LV2_URID perf_cyclesMax;
+    LV2_URID perf_cyclesAvg;
+    LV2_URID perf_hmiSetValue;
+    LV2_URID perf_hmiSetUnit;
+    LV2_URID perf_hmiSent;
+    LV2_URID perf_hmiSuppressed;
+    LV2_URID perf_events;
+    LV2_URID perf_forgeBytes;
+#endif
 } URIs;
 
 typedef struct {
-    LV2_Atom        unitstring;
-    char            unitstring_data[MAX_STRING];
+    const LV2_Atom* unitstring;  // a reference into the unit pool
+    LV2_Atom_Int    midi_cc;
+    LV2_Atom_Int    midi_nrpn;
+    LV2_Atom_Vector curve;       // x/y Float pairs, none for the linear response
+    float           curve_points[2 * CURVE_MAX_POINTS];
 } State;
 
+static inline const char*
+unit_text(const State* state)
+{
+    return (const char*)(state->unitstring + 1);
+}
+
+static inline uint32_t
+curve_n_points(const State* state)
+{
+    return (uint32_t)((state->curve.atom.size - sizeof(LV2_Atom_Vector_Body)) / (2 * sizeof(float)));
+}
+
+/** A curve for the worker to compile, the points are passed by value. */
+typedef struct {
+    uint32_t type;   // WORK_CURVE
+    uint32_t n_points;
+    float    points[2 * CURVE_MAX_POINTS];
+} CurveWork;
+
 typedef struct {
     uint32_t size;
     void *body;
@@ -96,7 +197,10 @@ map_uris(LV2_URID_Map* map, URIs* uris)
     uris->atom_URID          = map->map(map->handle, LV2_ATOM__URID);
     uris->atom_eventTransfer = map->map(map->handle, LV2_ATOM__eventTransfer);
     uris->atom_String        = map->map(map->handle, LV2_ATOM__String);
+    uris->atom_Bool          = map->map(map->handle, LV2_ATOM__Bool);
     uris->atom_Int           = map->map(map->handle, LV2_ATOM__Int);
+    uris->atom_Float         = map->map(map->handle, LV2_ATOM__Float);
+    uris->atom_Vector        = map->map(map->handle, LV2_ATOM__Vector);
     uris->midi_Event         = map->map(map->handle, LV2_MIDI__MidiEvent);
     uris->patch_Get          = map->map(map->handle, LV2_PATCH__Get);
     uris->patch_Set          = map->map(map->handle, LV2_PATCH__Set);
@@ -108,6 +212,30 @@ map_uris(LV2_URID_Map* map, URIs* uris)
     uris->state_StateChanged = map->map(map->handle, LV2_STATE__StateChanged);
 
     uris->unit_string       = map->map(map->handle, UNIT_STRING_URI);
+    uris->knob              = map->map(map->handle, KNOB_URI);
+    uris->midi_cc           = map->map(map->handle, MIDI_CC_URI);
+    uris->midi_nrpn         = map->map(map->handle, MIDI_NRPN_URI);
+    uris->midi_learn        = map->map(map->handle, MIDI_LEARN_URI);
+    uris->curve             = map->map(map->handle, CURVE_URI);
+    uris->output            = map->map(map->handle, OUTPUT_URI);
+    uris->scope             = map->map(map->handle, SCOPE_URI);
+
+#ifdef PERF_COUNTERS
+    uris->atom_Long         = map->map(map->handle, LV2_ATOM__Long);
+    uris->atom_Double       = map->map(map->handle, LV2_ATOM__Double);
+    uris->perf              = map->map(map->handle, PERF_URI);
+    uris->perf_runCalls     = map->map(map->handle, PERF_URI "RunCalls");
+    uris->perf_samples      = map->map(map->handle, PERF_URI "Samples");
+    uris->perf_cyclesMin    = map->map(map->handle, PERF_URI "CyclesMin");
+    uris->perf_cyclesMax    = map->map(map->handle, PERF_URI "CyclesMax");
+    uris->perf_cyclesAvg    = map->map(map->handle, PERF_URI "CyclesAvg");
+    uris->perf_hmiSetValue  = map->map(map->handle, PERF_URI "HmiSetValue");
+    uris->perf_hmiSetUnit   = map->map(map->handle, PERF_URI "HmiSetUnit");
+    uris->perf_hmiSent      = map->map(map->handle, PERF_URI "HmiSent");
+    uris->perf_hmiSuppressed = map->map(map->handle, PERF_URI "HmiSuppressed");
+    uris->perf_events       = map->map(map->handle, PERF_URI "Events");
+    uris->perf_forgeBytes   = map->map(map->handle, PERF_URI "ForgeBytes");
+#endif
 }
 
 typedef enum {
@@ -118,26 +246,115 @@ typedef enum {
     Max,
     PARAMS_IN,
     PARAMS_OUT,
-    ROUND
+    ROUND,
+    SmoothTime,
+    FallTime,
+    Mapping,
+    Invert,
+    ControlRate,
+    Interpolation,
+    ValueEvents,
+    EventThreshold,
+    CvInput,
+    Depth,
+    Quantize,
+    ScaleMask,
+    Hysteresis,
+    ScopeInterval
 } PortIndex;
 
+typedef enum {
+    MAPPING_KNOB = 0,
+    MAPPING_RANGE
+} OutputMapping;
+
+typedef enum {
+    INTERPOLATION_LINEAR = 0,
+    INTERPOLATION_HOLD
+} InterpolationMode;
+
+/**
+   Instance data.  What run() reads and writes every block comes first and is
+   packed into a few cache lines from the aligned start of the instance,
+   along with the URIs events are matched against.  The cold rest, the
+   state, the HMI and the worker, starts on a line of its own and is only
+   read when there is something to do: a dirty property, a display update or
+   a range to look up.  Flags in the hot part say so.  The bulky parts of
+   the cold rest are kept out of the instance: the unit string is shared in
+   the unit pool, the value tables are only allocated for a knob that gets
+   addressed and the curve tables for a curve that gets set.
+*/
 typedef struct {
-    
     //main knob
     const float* level;
 
-    // CV signals
-    float* output;
+    // CV signals, the input is optional
+    float*       output;
+    const float* cv_input;
 
     //controls
     const float* min;
     const float* max;
     const float* smooth;
+    const float* smooth_time;
+    const float* fall_time;
     const float *round;
+    const float* mapping;
+    const float* invert;
+    const float* control_rate;
+    const float* interpolation;
+    const float* value_events;
+    const float* event_threshold;
+    const float* depth;
+    const float* quantize;
+    const float* scale_mask;
+    const float* hysteresis;
+    const float* scope_interval;
+
+    // Ports
+    const LV2_Atom_Sequence* in_port;
+    LV2_Atom_Sequence*       out_port;
+    uint32_t                 notify_limit;
+
+    Smoother smoother;
+
+    // output mapping, out = gain * level + offset, gliding towards the targets
+    double rate;
+    float  gain;
+    float  offset;
+    float  gain_target;
+    float  offset_target;
+    bool   mapping_valid;
 
-    double a0;
-    double b1;
-    double z1;
+    // knob response, NULL while it is linear, applied before the mapping
+    const CurveTable* curve;
+    bool              curve_pending;   // the state has a curve to compile
+    bool              curve_sent;      // a curve went to the worker, its tables exist or are on the way
+
+    // published by restore() and the worker, checked at every block start
+    atomic_uint state_middle;  // STATE_FRESH when restore() published a state
+    atomic_uint curve_middle;  // STATE_FRESH when the worker published a curve
+
+    // Features and the addressing run() checks every block
+    LV2_HMI_WidgetControl* hmi;
+    LV2_Worker_Schedule*   schedule;
+    LV2_HMI_Addressing     control_addressing;
+
+    // what the cold part has to do
+    bool notify_pending;       // some property is dirty
+    bool hmi_posting;          // display updates to post or to schedule work for
+    bool addressing_changed;   // the value table may be for another addressing
+
+    // knob value in effect, set by the Knob port or by timestamped events
+    float knob;
+    float prev_knob_port;
+
+    // change-only output, Float deltas from the value the consumer holds
+    bool     events_on;
+    bool     event_sync;    // send the absolute value instead of deltas
+    bool     event_moved;   // deltas sent since the last absolute value
+    uint32_t events_sent;   // deltas sent in this block
+    float    event_value;
 
     bool state_changed;
 
@@ -145,226 +362,422 @@ typedef struct {
     float prev_min;
     float prev_max;
     int prev_round;
+    int64_t prev_key;
 
-    // Features
-    LV2_URID_Map*  map;
-    LV2_Log_Logger logger;
-    LV2_HMI_WidgetControl* hmi;
-    
     LV2_Atom_Forge forge;
     LV2_Atom_Forge_Ref ref;
 
-    // Ports
-    const LV2_Atom_Sequence* in_port;
-    LV2_Atom_Sequence*       out_port;
-    LV2_Atom_Forge_Frame notify_frame;
-
-    // URIs
     URIs uris;
 
-    // Plugin state
-    StateMapItem props[N_PROPS];
-    State        state;
+    // min/max envelope of the output, sent as plug:scope
+    Scope scope;
+
+    // notes the output is held to, after the mapping and the modulation, the
+    // table at its end is only read while quantizing
+    Quantizer quantizer;
+
+    // MIDI controller input, the next controller is assigned while learning
+    MidiControl midi __attribute__((aligned(CACHE_LINE)));
+    bool        midi_learn;
+
+    // Features
+    LV2_URID_Map*  map;
+    LV2_Log_Logger logger;
+
+    // Plugin state, triple buffered so restore() never writes what run() reads
+    StateMapItem    props[N_PROPS];
+    StateMap        state_map;
+    State           states[3];
+    uint32_t        prop_offset[N_PROPS];
+    const LV2_Atom* unit_default;
+    unsigned        state_front;   // used by run(), the props point into it
+    unsigned        state_back;    // filled by restore(), state_middle between them
+
+    // the unit of the front copy for other threads, with a reference of its own
+    _Atomic(const LV2_Atom*) unit_shown;
 
     // HMI Widgets stuff
-    LV2_HMI_Addressing control_addressing;
+    float              control_min;
+    float              control_max;
+    int                control_steps;
+
+    // Display updates handed to the worker
+    HmiRing hmi_ring;
+    bool    hmi_pending[HMI_UPDATE_COUNT];
+    bool    work_scheduled;
+
+    // Display text of every step, the worker allocates the pair on first use
+    // and builds the table run() does not read
+    _Atomic(HmiValueTable*) hmi_tables;
+    atomic_uint             hmi_table_live;
+    HmiTableKey             hmi_table_requested;
+
+    // Compiled curves, triple buffered like the state: the worker compiles
+    // into the back table and run() takes the published one at block start.
+    // They are allocated for the first curve that is not linear.  Without a
+    // worker restore() compiles instead and curves can only be restored.
+    _Atomic(CurveTable*) curve_tables;
+    unsigned             curve_front;
+    unsigned             curve_back;
+
+#ifdef PERF_COUNTERS
+    // Counters and the atom:Object they are reported in
+    PerfCounters   perf;
+    LV2_Atom_Forge perf_forge;
+    uint64_t       perf_atom[64];
+    bool           perf_dirty;   // asked for, sent with the dirty properties
+#endif
 } Control;
 
-static double
-lowPassProcess(Control* self, float input)
+/** Have a property sent to the UI at the end of a block. */
+static inline void
+mark_dirty(Control* self, StateMapItem* prop)
 {
-    return self->z1 = input * self->a0 + self->z1 * self->b1;
+    prop->dirty = true;
+    self->notify_pending = true;
 }
 
-float MAP(float x, float Imin, float Imax, float Omin, float Omax)
+/** Have the worker send a display update after the block. */
+static inline void
+post_hmi(Control* self, HmiUpdateType type)
 {
-    return (( x - Imin ) * (Omax -  Omin)  / (Imax - Imin) + Omin);
+    self->hmi_pending[type] = true;
+    self->hmi_posting = true;
 }
 
-//MOD products only support ascii 32 to 126
-void check_string(char *text)
+/** The knob level as shown, snapped to the steps of the current addressing. */
+static float
+screen_level(const Control* self)
 {
-    int char_lenght = strlen(text);
-    int ascii = 0;
-    for (int i = 0; i < char_lenght; i++) {
-        ascii = (int)text[i];
+    return snap_to_steps(self->knob, self->control_min, self->control_max, self->control_steps);
+}
 
-        //replace chars with -
-        if (ascii < 32)
-            text[i] = '-';
+static int64_t
+current_screen_key(const Control* self)
+{
+    return screen_value_key(screen_level(self), *self->min, *self->max, (int)*self->round == 1);
+}
 
-        //dont do quotation marks as they are tricky
-        if (ascii == 34)
-            text[i] = '-';
+static void
+screen_table_key(const Control* self, HmiTableKey* key)
+{
+    key->min         = *self->min;
+    key->max         = *self->max;
+    key->round       = (int)*self->round == 1;
+    key->control_min = self->control_min;
+    key->control_max = self->control_max;
+    key->steps       = self->control_steps;
+}
 
-        if (ascii > 126)
-            text[i] = '-';
-    }
+/**
+   The value table of the current range and addressing, NULL until the
+   worker has built it.  Only the worker writes tables, and never the one
+   run() reads, see work().
+*/
+static const HmiValueTable*
+screen_table(const Control* self)
+{
+    const HmiValueTable* tables = atomic_load_explicit(&self->hmi_tables, memory_order_acquire);
+    if (!tables)
+        return NULL;
+
+    const unsigned       live  = atomic_load_explicit(&self->hmi_table_live, memory_order_acquire);
+    const HmiValueTable* table = &tables[live];
+
+    HmiTableKey key;
+    screen_table_key(self, &key);
+
+    return table->valid && hmi_table_key_equal(&table->key, &key) ? table : NULL;
 }
 
-static char* reverse(char* str, uint32_t str_len)
+/** Ask the worker for the table of a new range or addressing, once. */
+static void
+request_screen_table(Control* self)
 {
-    char *end = str + (str_len - 1);
-    char *start = str, tmp;
+    HmiTableKey key;
+    screen_table_key(self, &key);
 
-    while (start < end)
-    {
-        tmp = *end;
-        *end = *start;
-        *start = tmp;
+    if (!hmi_table_supported(&key) || hmi_table_key_equal(&key, &self->hmi_table_requested))
+        return;
 
-        start++;
-        end--;
-    }
+    self->hmi_table_requested = key;
+    post_hmi(self, HMI_UPDATE_TABLE);
+}
 
-    return str;
+void update_screen_value(Control* self)
+{
+    char bfr[SCREEN_VALUE_SIZE];
+    format_screen_value(bfr, sizeof(bfr), screen_level(self), *self->min, *self->max, (int)*self->round == 1);
+
+    //change HMI
+    self->hmi->set_value(self->hmi->handle, self->control_addressing, bfr);
+    PERF_COUNT_HMI(&self->perf, hmi_set_value);
+
+    self->prev_value = self->knob;
+    self->prev_min = *self->min;
+    self->prev_max = *self->max;
+    self->prev_round = *self->round;
+    self->prev_key = current_screen_key(self);
 }
 
-uint32_t int_to_str(int32_t num, char *string, uint32_t string_size, uint8_t zero_leading)
+/**
+   Hand pending display updates to the worker.
+   Runs in the audio thread, updates that do not fit in the ring stay pending
+   and are retried on the next block with the then current values.  Nothing
+   is looked at while there is nothing to post.
+*/
+static void
+post_hmi_updates(Control* self)
 {
-    char *pstr = string;
-    uint8_t signal = 0;
-    uint32_t str_len;
+    if (!self->hmi_posting)
+        return;
 
-    if (!string) return 0;
+    bool left = false;
 
-    // exception case: number is zero
-    if (num == 0)
-    {
-        *pstr++ = '0';
-        if (zero_leading) zero_leading--;
-    }
+    for (int type = 0; type < HMI_UPDATE_COUNT; type++) {
+        if (!self->hmi_pending[type])
+            continue;
 
-    // need minus signal?
-    if (num < 0)
-    {
-        num = -num;
-        signal = 1;
-        string_size--;
-    }
+        HmiUpdate update;
+        update.type    = (HmiUpdateType)type;
+        update.channel = 0;
 
-    // composes the string
-    while (num)
-    {
-        *pstr++ = (num % 10) + '0';
-        num /= 10;
+        if (type == HMI_UPDATE_VALUE) {
+            const HmiValueTable* table = screen_table(self);
 
-        if (--string_size == 0) break;
-        if (zero_leading) zero_leading--;
+            update.data.value.level = screen_level(self);
+            update.data.value.min   = *self->min;
+            update.data.value.max   = *self->max;
+            update.data.value.round = (int)*self->round == 1;
+            update.data.value.text  = table ? table->text[hmi_table_step(table, self->knob)] : NULL;
+        }
+        else if (type == HMI_UPDATE_TABLE) {
+            update.data.table = self->hmi_table_requested;
+        }
+        else {
+            strncpy(update.data.unit, unit_text(&self->states[self->state_front]), HMI_UNIT_SIZE - 1);
+            update.data.unit[HMI_UNIT_SIZE - 1] = '\0';
+        }
+
+        if (!hmi_ring_push(&self->hmi_ring, &update)) {
+            left = true;
+            break;
+        }
+
+        self->hmi_pending[type] = false;
     }
 
-    // checks buffer size
-    if (string_size == 0)
-    {
-        *string = 0;
-        return 0;
+    if (!self->work_scheduled && !hmi_ring_empty(&self->hmi_ring)) {
+        const uint32_t token = WORK_HMI;
+        if (self->schedule->schedule_work(self->schedule->handle, sizeof(token), &token) == LV2_WORKER_SUCCESS)
+            self->work_scheduled = true;
+        else
+            left = true;
     }
 
-    // fills the zeros leading
-    while (zero_leading--) *pstr++ = '0';
+    // scheduled work posts again when it is done, see work_response()
+    self->hmi_posting = left;
+}
+
+/**
+   The value of property entry in a copy of the state.  The unit string, the
+   only string, is held by reference.
+*/
+static inline LV2_Atom*
+state_value(const Control* self, State* state, const StateMapItem* entry)
+{
+    uint8_t* field = (uint8_t*)state + self->prop_offset[entry - self->props];
+
+    return entry->type == self->uris.atom_String ? (LV2_Atom*)*(const LV2_Atom**)field
+                                                 : (LV2_Atom*)field;
+}
+
+/**
+   A reference to the pooled atom of a unit text, as the display shows it: no
+   text is the default unit and characters the display lacks are replaced.
+   NULL if the pool has no room for it.
+*/
+static const LV2_Atom*
+intern_unit(const Control* self, const char* text)
+{
+    char unit[MAX_STRING];
 
-    // put the minus if necessary
-    if (signal) *pstr++ = '-';
-    *pstr = 0;
+    strncpy(unit, text[0] ? text : UNIT_STRING_TEXT, sizeof(unit) - 1);
+    unit[sizeof(unit) - 1] = '\0';
 
-    // invert the string characters
-    str_len = (pstr - string);
-    reverse(string, str_len);
+    //sanity check for the chars we want to display
+    check_string(unit);
 
-    return str_len;
+    return unit_pool_intern(self->uris.atom_String, unit, (uint32_t)strlen(unit) + 1);
 }
 
-uint32_t float_to_str(float num, char *string, uint32_t string_size, uint8_t precision)
+/**
+   Put a copy back to the defaults, the default unit, no MIDI controller and
+   the linear response.
+*/
+static void
+state_reset(const Control* self, State* state)
 {
-    double intp, fracp;
-    char *str = string;
+    const URIs* uris = &self->uris;
+
+    unit_pool_release(state->unitstring);
+    state->unitstring = unit_pool_retain(self->unit_default);
+
+    state->curve.atom.type       = uris->atom_Vector;
+    state->curve.atom.size       = sizeof(LV2_Atom_Vector_Body);
+    state->curve.body.child_size = sizeof(float);
+    state->curve.body.child_type = uris->atom_Float;
+
+    state->midi_cc.atom.type   = uris->atom_Int;
+    state->midi_cc.atom.size   = sizeof(int32_t);
+    state->midi_cc.body        = MIDI_CONTROL_NONE;
+    state->midi_nrpn.atom.type = uris->atom_Int;
+    state->midi_nrpn.atom.size = sizeof(int32_t);
+    state->midi_nrpn.body      = MIDI_CONTROL_NONE;
+}
 
-    if (!string) return 0;
+/**
+   Show the unit of the front copy to addressed() and save().  Runs in the
+   audio thread whenever the front unit changes, the one shown before is only
+   given up once the new one is in place.
+*/
+static void
+publish_unit(Control* self)
+{
+    const LV2_Atom* unit = unit_pool_retain(self->states[self->state_front].unitstring);
 
-    // TODO: check Nan and Inf
+    unit_pool_release(atomic_exchange_explicit(&self->unit_shown, unit, memory_order_acq_rel));
+}
 
-    // splits integer and fractional parts
-    fracp = modf(num, &intp);
+/**
+   A reference to the unit run() shows, for other threads.  It holds the
+   string when it is still the one shown after taking it.  While run() keeps
+   replacing it this gives up after a few tries with the default unit.
+*/
+static const LV2_Atom*
+acquire_shown_unit(Control* self)
+{
+    for (int i = 0; i < UNIT_SHOWN_TRIES; i++) {
+        const LV2_Atom* unit = atomic_load_explicit(&self->unit_shown, memory_order_acquire);
+        if (!unit_pool_try_retain(unit))
+            continue;
 
-    // convert to absolute value
-    if (intp < 0.0) intp = -intp;
-    if (fracp < 0.0) fracp = -fracp;
+        if (atomic_load_explicit(&self->unit_shown, memory_order_acquire) == unit)
+            return unit;
 
-    // insert minus if negative number
-    if (num < 0.0)
-    {
-        *str = '-';
-        str++;
+        unit_pool_release(unit);
     }
 
-    // convert the integer part to string
-    uint32_t int_len;
-    int_len = int_to_str((int32_t)intp, str, string_size, 0);
+    return unit_pool_retain(self->unit_default);
+}
 
-    // checks if convertion fail
-    if (int_len == 0)
-    {
-        *string = 0;
-        return 0;
-    }
+/**
+   Adopt the state restore() published since the last block, if any.
+   Runs in the audio thread at block start.  The copy given up in exchange
+   is the one restore() fills next, so nothing run() reads is ever written.
+*/
+static void
+state_acquire(Control* self)
+{
+    if (!(atomic_load_explicit(&self->state_middle, memory_order_relaxed) & STATE_FRESH))
+        return;
 
-    // adds one to avoid lost the leading zeros
-    fracp += 1.0;
+    const unsigned fresh = atomic_exchange_explicit(&self->state_middle, self->state_front,
+                                                    memory_order_acq_rel);
+    self->state_front = fresh & ~STATE_FRESH;
 
-    // calculates the precision
-    while (precision--)
-    {
-        fracp *= 10;
+    State* state = &self->states[self->state_front];
+    for (unsigned i = 0; i < N_PROPS; ++i) {
+        self->props[i].value = state_value(self, state, &self->props[i]);
+        mark_dirty(self, &self->props[i]);
     }
 
-    // add 0.5 to round
-    fracp += 0.5;
+    publish_unit(self);
+    self->state_changed = true;
+    self->curve_pending = true;
+}
 
-    // convert the fractional part
-    uint32_t frac_len;
-    frac_len = int_to_str((int32_t)fracp, &str[int_len], string_size - int_len, 0);
+/**
+   Take the curve table the worker published since the last block, if any.
+   Runs in the audio thread at block start, the table given up in exchange
+   is the one the worker compiles next.
+*/
+static void
+curve_acquire(Control* self)
+{
+    if (!(atomic_load_explicit(&self->curve_middle, memory_order_relaxed) & STATE_FRESH))
+        return;
 
-    // checks if convertion fail
-    if (frac_len == 0)
-    {
-        *string = 0;
-        return 0;
+    const unsigned fresh = atomic_exchange_explicit(&self->curve_middle, self->curve_front,
+                                                    memory_order_acq_rel);
+    self->curve_front = fresh & ~STATE_FRESH;
+
+    const CurveTable* table = &atomic_load_explicit(&self->curve_tables, memory_order_acquire)[self->curve_front];
+    self->curve = table->linear ? NULL : table;
+}
+
+/**
+   Compile a curve into the back table and publish it for run().  Called by
+   the worker, or by restore() without one, never by both.  The tables are
+   allocated on first use.
+*/
+static bool
+curve_publish(Control* self, const float* points, uint32_t n_points)
+{
+    CurveTable* tables = atomic_load_explicit(&self->curve_tables, memory_order_relaxed);
+    if (!tables) {
+        tables = (CurveTable*)calloc(3, sizeof(CurveTable));
+        if (!tables)
+            return false;
+        atomic_store_explicit(&self->curve_tables, tables, memory_order_release);
     }
 
-    // inserts the dot covering the extra one added
-    str[int_len] = '.';
+    curve_compile(&tables[self->curve_back], points, n_points);
+
+    const unsigned old = atomic_exchange_explicit(&self->curve_middle,
+                                                  self->curve_back | STATE_FRESH,
+                                                  memory_order_acq_rel);
+    self->curve_back = old & ~STATE_FRESH;
 
-    return (int_len + frac_len);
+    return true;
 }
 
-void update_screen_value(Control* self)
+/**
+   Have the curve of the state compiled.  The worker gets the points by value,
+   so run() may change them again right away.  Without a worker the linear
+   response is all run() sets, restore() has published any other curve.
+*/
+static void
+request_curve(Control* self)
 {
-    char bfr[8];
-    if ((int)*self->round == 1){
-        float minRound = roundf(*self->min);
-        float maxRound = roundf(*self->max);
-        int screen_value = roundf(MAP(*self->level, 0, 10, minRound, maxRound));
-        int_to_str(screen_value, bfr, sizeof(bfr), 0);
-    }
-    else {
-        float screen_value = MAP(*self->level, 0, 10, *self->min, *self->max);
-        
-        //mimic MOD Dwarf HMI behaviour
-        if ((screen_value > 99.99) || (screen_value < -99.99))
-            float_to_str((screen_value), bfr, sizeof(bfr), 1);
-        else if ((screen_value > 9.99) || (screen_value < -9.99))
-            float_to_str((screen_value), bfr, sizeof(bfr), 2);
-        else
-            float_to_str((screen_value), bfr, sizeof(bfr), 3);
+    if (!self->curve_pending)
+        return;
+
+    const State*   state    = &self->states[self->state_front];
+    const uint32_t n_points = curve_n_points(state);
+
+    if (!self->schedule) {
+        if (n_points == 0)
+            self->curve = NULL;
+        self->curve_pending = false;
+        return;
     }
 
-    //change HMI
-    self->hmi->set_value(self->hmi->handle, self->control_addressing, bfr);
+    // still linear, the tables are only allocated for a first real curve
+    if (n_points == 0 && !self->curve && !self->curve_sent) {
+        self->curve_pending = false;
+        return;
+    }
 
-    self->prev_value = *self->level;
-    self->prev_min = *self->min;
-    self->prev_max = *self->max;
-    self->prev_round = *self->round;
+    CurveWork work;
+    work.type     = WORK_CURVE;
+    work.n_points = n_points;
+    memcpy(work.points, state->curve_points, 2 * n_points * sizeof(float));
+
+    if (self->schedule->schedule_work(self->schedule->handle, sizeof(work), &work) == LV2_WORKER_SUCCESS) {
+        self->curve_pending = false;
+        self->curve_sent    = true;
+    }
 }
 
 static LV2_Handle
@@ -373,7 +786,12 @@ instantiate(const LV2_Descriptor*     descriptor,
             const char*               bundle_path,
             const LV2_Feature* const* features)
 {
-    Control* self = (Control*)calloc(sizeof(Control), 1);
+    // the hot part of the instance starts on a cache line
+    Control* self = NULL;
+    if (posix_memalign((void**)&self, CACHE_LINE, sizeof(Control)))
+        return NULL;
+
+    memset(self, 0, sizeof(*self));
 
     // Get host features
     // clang-format off
@@ -382,6 +800,7 @@ instantiate(const LV2_Descriptor*     descriptor,
             LV2_LOG__log,           &self->logger.log,  false,
             LV2_URID__map,          &self->map,         true,
             LV2_HMI__WidgetControl, &self->hmi,         false,
+            LV2_WORKER__schedule,   &self->schedule,    false,
             NULL);
     // clang-format on
 
@@ -397,23 +816,84 @@ instantiate(const LV2_Descriptor*     descriptor,
     map_uris(self->map, &self->uris);
     lv2_atom_forge_init(&self->forge, self->map);
 
-    // Initialise state dictionary
+    // Initialise state dictionary, the unit string atom only takes the type
+    // and size, the state refers to the pooled one
     // clang-format off
-    State* state = &self->state;
+    State*   state = &self->states[0];
+    LV2_Atom unit;
     state_map_init(
-        self->props, self->map, self->map->handle,
-        UNIT_STRING_URI, STATE_MAP_INIT(String, &state->unitstring),
+        &self->state_map, self->props, self->map, self->map->handle,
+        UNIT_STRING_URI, LV2_ATOM__String, (uint32_t)MAX_STRING, &unit,
+        MIDI_CC_URI,     STATE_MAP_INIT(Int, &state->midi_cc),
+        MIDI_NRPN_URI,   STATE_MAP_INIT(Int, &state->midi_nrpn),
+        CURVE_URI,       LV2_ATOM__Vector,
+                         (uint32_t)(sizeof(LV2_Atom_Vector_Body) + sizeof(state->curve_points)),
+                         &state->curve.atom,
         NULL);
     // clang-format on
 
-    self->z1 = 0.0;
-    double frequency = 550.0 / rate;
-    self->b1 = exp(-2.0 * M_PI * frequency);
-    self->a0 = 1.0 - self->b1;
+    // the same property sits at the same offset in every copy
+    for (unsigned i = 0; i < N_PROPS; ++i) {
+        self->prop_offset[i] = self->props[i].type == self->uris.atom_String
+                             ? (uint32_t)offsetof(State, unitstring)
+                             : (uint32_t)((uint8_t*)self->props[i].value - (uint8_t*)state);
+    }
+
+    self->rate = rate;
+    smoother_init(&self->smoother, rate, KNOB_MAX - KNOB_MIN,
+                  SMOOTH_ONE_POLE, SMOOTH_TIME_DEFAULT, SMOOTH_TIME_DEFAULT);
+
+    quantizer_init(&self->quantizer);
+    hmi_ring_init(&self->hmi_ring);
+    atomic_init(&self->hmi_tables, NULL);
+    atomic_init(&self->hmi_table_live, 0);
+    midi_control_init(&self->midi);
+
+    atomic_init(&self->curve_tables, NULL);
+    self->curve_front = 0;
+    self->curve_back  = 2;
+    atomic_init(&self->curve_middle, 1);
+
+#ifdef PERF_COUNTERS
+    perf_init(&self->perf);
+    lv2_atom_forge_init(&self->perf_forge, self->map);
+#endif
+    self->prev_key = INT64_MIN;
+
+    // every instance starts with the same unit string from the pool, taken
+    // last so there are no references to give back on failure
+    self->unit_default = intern_unit(self, "");
+    if (!self->unit_default) {
+        lv2_log_error(&self->logger, "Unit string pool is full\n");
+        free(self);
+        return NULL;
+    }
+
+    for (unsigned i = 0; i < 3; ++i)
+        state_reset(self, &self->states[i]);
+
+    for (unsigned i = 0; i < N_PROPS; ++i)
+        self->props[i].value = state_value(self, state, &self->props[i]);
+
+    self->state_front = 0;
+    self->state_back  = 2;
+    atomic_init(&self->state_middle, 1);
+    atomic_init(&self->unit_shown, unit_pool_retain(state->unitstring));
 
     return (LV2_Handle)self;
 }
 
+/** Whether a vector body of size bytes holds the points of a curve. */
+static bool
+curve_body_valid(const Control* self, const LV2_Atom_Vector_Body* body, uint32_t size)
+{
+    if (size < sizeof(*body) || body->child_type != self->uris.atom_Float ||
+        body->child_size != sizeof(float) || (size - sizeof(*body)) % (2 * sizeof(float)))
+        return false;
+
+    return curve_points_valid((const float*)(body + 1), (uint32_t)((size - sizeof(*body)) / (2 * sizeof(float))));
+}
+
 static LV2_State_Status
 set_parameter(Control*     self,
               LV2_URID    key,
@@ -423,20 +903,119 @@ set_parameter(Control*     self,
               bool        from_state)
 {
     // Look up property in state dictionary
-    const StateMapItem* entry = state_map_find(self->props, N_PROPS, key);
+    StateMapItem* entry = state_map_find(&self->state_map, key);
+    if (!entry) {
+        return LV2_STATE_ERR_NO_PROPERTY;
+    }
+
+    // Values of the wrong type or size, unterminated strings and curves that
+    // are not Float pairs from 0 to 1 are refused
+    const bool is_string = type == self->uris.atom_String;
+    const bool is_curve  = key == self->uris.curve;
+    if (type != entry->type || size > entry->max_size ||
+        (!is_string && !is_curve && size != entry->max_size) ||
+        (is_string && (size == 0 || ((const char*)body)[size - 1] != '\0')) ||
+        (is_curve && !curve_body_valid(self, (const LV2_Atom_Vector_Body*)body, size))) {
+        lv2_log_error(&self->logger, "Bad value for <%s>\n", entry->uri);
+        return LV2_STATE_ERR_BAD_TYPE;
+    }
+
+    // run() does not compile curves, without a worker they can only be restored
+    if (is_curve && !from_state && !self->schedule && size > sizeof(LV2_Atom_Vector_Body)) {
+        lv2_log_error(&self->logger, "Set <%s> needs a worker\n", entry->uri);
+        return LV2_STATE_ERR_BAD_FLAGS;
+    }
 
     // Set property value in state dictionary
     lv2_log_trace(&self->logger, "Set <%s>\n", entry->uri);
+
+    if (is_string) {
+        // the unit string, looked up or added in the pool without locking
+        const LV2_Atom* unit = intern_unit(self, (const char*)body);
+        if (!unit) {
+            lv2_log_error(&self->logger, "No room for <%s>\n", entry->uri);
+            return LV2_STATE_ERR_NO_SPACE;
+        }
+
+        State* state = &self->states[from_state ? self->state_back : self->state_front];
+        unit_pool_release(state->unitstring);
+        state->unitstring = unit;
+        if (from_state)
+            return LV2_STATE_SUCCESS;
+
+        entry->value = (LV2_Atom*)unit;
+        publish_unit(self);
+        mark_dirty(self, entry);
+        self->state_changed = true;
+        return LV2_STATE_SUCCESS;
+    }
+
+    if (from_state) {
+        // restore() fills the back copy, run() picks it up as a whole
+        LV2_Atom* value = state_value(self, &self->states[self->state_back], entry);
+        memcpy(value + 1, body, size);
+        value->size = size;
+        return LV2_STATE_SUCCESS;
+    }
+
     memcpy(entry->value + 1, body, size);
     entry->value->size = size;
+    mark_dirty(self, entry);
     self->state_changed = true;
+    self->curve_pending |= is_curve;
     return LV2_STATE_SUCCESS;
 }
 
+#ifdef PERF_COUNTERS
+/** Snapshot of the counters as an atom:Object, the value of the read-only perf property. */
+static const LV2_Atom*
+perf_to_atom(Control* self)
+{
+    const URIs*         uris  = &self->uris;
+    const PerfCounters* perf  = &self->perf;
+    LV2_Atom_Forge*     forge = &self->perf_forge;
+
+    lv2_atom_forge_set_buffer(forge, (uint8_t*)self->perf_atom, sizeof(self->perf_atom));
+
+    LV2_Atom_Forge_Frame frame;
+    lv2_atom_forge_object(forge, &frame, 0, uris->perf);
+    lv2_atom_forge_key(forge, uris->perf_runCalls);
+    lv2_atom_forge_long(forge, (int64_t)perf->run_calls);
+    lv2_atom_forge_key(forge, uris->perf_samples);
+    lv2_atom_forge_long(forge, (int64_t)perf->samples);
+    lv2_atom_forge_key(forge, uris->perf_cyclesMin);
+    lv2_atom_forge_long(forge, perf->run_calls ? (int64_t)perf->cycles_min : 0);
+    lv2_atom_forge_key(forge, uris->perf_cyclesMax);
+    lv2_atom_forge_long(forge, (int64_t)perf->cycles_max);
+    lv2_atom_forge_key(forge, uris->perf_cyclesAvg);
+    lv2_atom_forge_double(forge, perf->cycles_ewma);
+    lv2_atom_forge_key(forge, uris->perf_hmiSetValue);
+    lv2_atom_forge_long(forge, (int64_t)atomic_load_explicit(&perf->hmi_set_value, memory_order_relaxed));
+    lv2_atom_forge_key(forge, uris->perf_hmiSetUnit);
+    lv2_atom_forge_long(forge, (int64_t)atomic_load_explicit(&perf->hmi_set_unit, memory_order_relaxed));
+    lv2_atom_forge_key(forge, uris->perf_hmiSent);
+    lv2_atom_forge_long(forge, (int64_t)atomic_load_explicit(&perf->hmi_sent, memory_order_relaxed));
+    lv2_atom_forge_key(forge, uris->perf_hmiSuppressed);
+    lv2_atom_forge_long(forge, (int64_t)perf->hmi_suppressed);
+    lv2_atom_forge_key(forge, uris->perf_events);
+    lv2_atom_forge_long(forge, (int64_t)perf->events);
+    lv2_atom_forge_key(forge, uris->perf_forgeBytes);
+    lv2_atom_forge_long(forge, (int64_t)perf->forge_bytes);
+    lv2_atom_forge_pop(forge, &frame);
+
+    return (const LV2_Atom*)self->perf_atom;
+}
+#endif
+
 static const LV2_Atom*
 get_parameter(Control* self, LV2_URID key)
 {
-    const StateMapItem* entry = state_map_find(self->props, N_PROPS, key);
+#ifdef PERF_COUNTERS
+    if (key == self->uris.perf)
+        return perf_to_atom(self);
+#endif
+
+    const StateMapItem* entry = state_map_find(&self->state_map, key);
     if (entry) {
         lv2_log_trace(&self->logger, "Get <%s>\n", entry->uri);
         return entry->value;
@@ -509,7 +1088,15 @@ save(LV2_Handle                instance,
     LV2_State_Status st = LV2_STATE_SUCCESS;
     for (unsigned i = 0; i < N_PROPS; ++i) {
         StateMapItem* prop = &self->props[i];
-        store_prop(self, map_path, &st, store, handle, prop->urid, prop->value);
+        if (prop->type != self->uris.atom_String) {
+            store_prop(self, map_path, &st, store, handle, prop->urid, prop->value);
+            continue;
+        }
+
+        // run() may replace the unit meanwhile, the one stored is held until written
+        const LV2_Atom* unit = acquire_shown_unit(self);
+        store_prop(self, map_path, &st, store, handle, prop->urid, unit);
+        unit_pool_release(unit);
     }
 
     return st;
@@ -539,7 +1126,12 @@ retrieve_prop(Control*                     self,
     }
 }
 
-/** State restore method. */
+/**
+   State restore method.
+   May run concurrently with run().  The properties are restored into a copy
+   run() does not use, missing or bad ones are left at their default, and
+   the copy is then published in one atomic exchange.
+*/
 static LV2_State_Status
 restore(LV2_Handle                  instance,
         LV2_State_Retrieve_Function retrieve,
@@ -550,11 +1142,27 @@ restore(LV2_Handle                  instance,
   Control*         self = (Control*)instance;
   LV2_State_Status st   = LV2_STATE_SUCCESS;
 
+  state_reset(self, &self->states[self->state_back]);
+
   for (unsigned i = 0; i < N_PROPS; ++i) {
     retrieve_prop(self, &st, retrieve, handle, self->props[i].urid, features);
   }
 
-  self->state_changed = true;
+  // without a worker a curve is compiled here, before run() can see its state
+  State*         state    = &self->states[self->state_back];
+  const uint32_t n_points = curve_n_points(state);
+  if (!self->schedule && n_points && !curve_publish(self, state->curve_points, n_points)) {
+    lv2_log_error(&self->logger, "No room for the curve\n");
+    state->curve.atom.size = sizeof(LV2_Atom_Vector_Body);
+    if (!st)
+      st = LV2_STATE_ERR_NO_SPACE;
+  }
+
+  // an older copy run() has not picked up yet comes back and is reused
+  const unsigned old = atomic_exchange_explicit(&self->state_middle,
+                                                self->state_back | STATE_FRESH,
+                                                memory_order_acq_rel);
+  self->state_back = old & ~STATE_FRESH;
 
   return st;
 }
@@ -567,6 +1175,70 @@ subject_is_plugin(Control* self, const LV2_Atom_URID* subject)
                          subject->body == self->uris.plugin));
 }
 
+/** Whether a patch:Set of value still fits in the output budget of this block. */
+static inline bool
+notify_fits(const Control* self, const LV2_Atom* value)
+{
+    return self->forge.offset + NOTIFY_OVERHEAD + lv2_atom_pad_size(value->size) <= self->notify_limit;
+}
+
+static void
+forge_set(Control* self, int64_t frames, LV2_URID key, const LV2_Atom* value)
+{
+    LV2_Atom_Forge* forge = &self->forge;
+    const URIs*     uris  = &self->uris;
+
+    lv2_atom_forge_frame_time(forge, frames);
+    LV2_Atom_Forge_Frame frame;
+    lv2_atom_forge_object(forge, &frame, 0, uris->patch_Set);
+    lv2_atom_forge_key(forge, uris->patch_property);
+    lv2_atom_forge_urid(forge, key);
+    store_prop(self, NULL, NULL, write_param_to_forge, forge, uris->patch_value, value);
+    lv2_atom_forge_pop(forge, &frame);
+}
+
+/**
+   Send a patch:Set for the dirty properties, as far as the output budget of
+   this block allows.  The rest stays dirty and goes out in the next blocks.
+*/
+static void
+notify_dirty_props(Control* self, int64_t frames)
+{
+    if (!self->notify_pending)
+        return;
+
+    self->notify_pending = false;
+
+    for (unsigned i = 0; i < N_PROPS; ++i) {
+        StateMapItem* prop = &self->props[i];
+
+        if (!prop->dirty)
+            continue;
+        if (!notify_fits(self, prop->value)) {
+            self->notify_pending = true;
+            break;
+        }
+
+        forge_set(self, frames, prop->urid, prop->value);
+        prop->dirty = false;
+    }
+
+#ifdef PERF_COUNTERS
+    // after the properties, a snapshot that does not fit is taken again next block
+    if (self->perf_dirty && !self->notify_pending) {
+        const LV2_Atom* perf = perf_to_atom(self);
+
+        if (notify_fits(self, perf)) {
+            forge_set(self, frames, self->uris.perf, perf);
+            self->perf_dirty = false;
+        }
+        else {
+            self->notify_pending = true;
+        }
+    }
+#endif
+}
+
 static void
 connect_port(LV2_Handle instance,
              uint32_t   port,
@@ -599,7 +1271,466 @@ connect_port(LV2_Handle instance,
         case ROUND:
             self->round = (const float*)data;
             break;
+        case SmoothTime:
+            self->smooth_time = (const float*)data;
+            break;
+        case FallTime:
+            self->fall_time = (const float*)data;
+            break;
+        case Mapping:
+            self->mapping = (const float*)data;
+            break;
+        case Invert:
+            self->invert = (const float*)data;
+            break;
+        case ControlRate:
+            self->control_rate = (const float*)data;
+            break;
+        case Interpolation:
+            self->interpolation = (const float*)data;
+            break;
+        case ValueEvents:
+            self->value_events = (const float*)data;
+            break;
+        case EventThreshold:
+            self->event_threshold = (const float*)data;
+            break;
+        case CvInput:
+            self->cv_input = (const float*)data;
+            break;
+        case Depth:
+            self->depth = (const float*)data;
+            break;
+        case Quantize:
+            self->quantize = (const float*)data;
+            break;
+        case ScaleMask:
+            self->scale_mask = (const float*)data;
+            break;
+        case Hysteresis:
+            self->hysteresis = (const float*)data;
+            break;
+        case ScopeInterval:
+            self->scope_interval = (const float*)data;
+            break;
+    }
+}
+
+static bool
+range_mapping(const Control* self)
+{
+    return (int)*self->mapping == MAPPING_RANGE;
+}
+
+/**
+   Output range as the Min and Max the level is mapped to, rounded like the
+   display when Round is on.  Without range mapping it is the knob range.
+*/
+static void
+output_range(const Control* self, float* lo, float* hi)
+{
+    *lo = KNOB_MIN;
+    *hi = KNOB_MAX;
+
+    if (range_mapping(self)) {
+        *lo = *self->min;
+        *hi = *self->max;
+
+        if ((int)*self->round == 1) {
+            *lo = roundf(*lo);
+            *hi = roundf(*hi);
+        }
+    }
+}
+
+/**
+   Fold the range and the inversion into the gain and offset the output glides
+   to.  A new range is applied at once the first time and without smoothing.
+*/
+static void
+update_output_mapping(Control* self)
+{
+    float lo, hi;
+    output_range(self, &lo, &hi);
+
+    if ((int)*self->invert == 1) {
+        const float swap = lo;
+        lo = hi;
+        hi = swap;
+    }
+
+    self->gain_target   = (hi - lo) / (KNOB_MAX - KNOB_MIN);
+    self->offset_target = lo - KNOB_MIN * self->gain_target;
+
+    if (!self->mapping_valid || self->smoother.mode == SMOOTH_OFF) {
+        self->gain          = self->gain_target;
+        self->offset        = self->offset_target;
+        self->mapping_valid = true;
+    }
+}
+
+/** Whether Round makes the output whole numbers, only in range mode. */
+static bool
+round_output(const Control* self)
+{
+    return range_mapping(self) && (int)*self->round == 1;
+}
+
+/**
+   Level the smoother moves to.  With Round in range mode it is moved to the
+   nearest level that maps to a whole number, so the output settles on it.
+   A curve comes between the level and the output, then the output itself
+   is rounded instead.
+*/
+static float
+target_level(const Control* self)
+{
+    if (!round_output(self) || self->curve)
+        return self->knob;
+
+    float lo, hi;
+    output_range(self, &lo, &hi);
+
+    if (hi == lo)
+        return self->knob;
+
+    const float value = roundf(MAP(self->knob, KNOB_MIN, KNOB_MAX, lo, hi));
+    return MAP(value, lo, hi, KNOB_MIN, KNOB_MAX);
+}
+
+/**
+   Render n_samples of the output towards level.
+   The mapping is applied by the smoother itself, only while Min or Max glide
+   to a new value, or with a curve between the smoothed level and the
+   mapping, the block is mapped in short chunks with ramping gain and offset.
+   With a curve Round applies to the mapped output, after the curve.
+*/
+static void
+render_level(Control* self, float level, float* out, uint32_t n_samples)
+{
+    const CurveTable* curve = self->curve;
+
+    if (!curve && self->gain == self->gain_target && self->offset == self->offset_target) {
+        smoother_render(&self->smoother, level, self->gain, self->offset, out, n_samples);
+        return;
+    }
+
+    // the range follows a one-pole with the smoothing time, interpolated per chunk
+    const double time  = self->smoother.time_ms * 0.001 * self->rate;
+    const float  scale = fabsf(self->gain_target) + fabsf(self->offset_target) + 1.0f;
+    const bool   whole = curve && round_output(self);
+    float        level_out[RANGE_CHUNK];
+
+    while (n_samples) {
+        const uint32_t n       = n_samples < RANGE_CHUNK ? n_samples : RANGE_CHUNK;
+        const bool     gliding = self->gain != self->gain_target || self->offset != self->offset_target;
+        const float    decay   = gliding && time > 0.0 ? (float)exp(-(double)n / time) : 0.0f;
+
+        float gain   = self->gain_target + (self->gain - self->gain_target) * decay;
+        float offset = self->offset_target + (self->offset - self->offset_target) * decay;
+
+        if (fabsf(gain - self->gain_target) + fabsf(offset - self->offset_target) < scale * 1e-6f) {
+            gain   = self->gain_target;
+            offset = self->offset_target;
+        }
+
+        const float gain_step   = (gain - self->gain) / (float)n;
+        const float offset_step = (offset - self->offset) / (float)n;
+
+        smoother_render(&self->smoother, level, 1.0f, 0.0f, level_out, n);
+        if (curve)
+            curve_render(curve, level_out, n, KNOB_MAX - KNOB_MIN);
+
+        for (uint32_t i = 0; i < n; i++)
+            out[i] = level_out[i] * (self->gain + gain_step * (float)(i + 1))
+                   + (self->offset + offset_step * (float)(i + 1));
+
+        if (whole) {
+            for (uint32_t i = 0; i < n; i++)
+                out[i] = roundf(out[i]);
+        }
+
+        self->gain   = gain;
+        self->offset = offset;
+        out       += n;
+        n_samples -= n;
+
+        if (!curve && gain == self->gain_target && offset == self->offset_target) {
+            smoother_render(&self->smoother, level, gain, offset, out, n_samples);
+            return;
+        }
+    }
+}
+
+/**
+   Set the quantizer up for this block.  Scales are at 1 V per octave from
+   0 V, equal steps divide the output range by the steps of the addressing
+   and quantize nothing while the knob is not addressed.
+*/
+static void
+update_quantizer(Control* self)
+{
+    const int mode = (int)*self->quantize;
+    float origin = 0.0f;
+    float period = 1.0f;
+
+    if (mode == QUANTIZE_STEPS) {
+        float lo, hi;
+        output_range(self, &lo, &hi);
+
+        origin = lo < hi ? lo : hi;
+        period = self->control_steps >= 2 ? fabsf(hi - lo) / (float)(self->control_steps - 1) : 0.0f;
+    }
+
+    quantizer_configure(&self->quantizer, (QuantizeMode)mode, (uint32_t)(int)*self->scale_mask,
+                        origin, period, *self->hysteresis);
+}
+
+/**
+   Output range the gain and offset map the knob range to right now, while
+   Min or Max glide it is between the old range and the new one.
+*/
+static void
+smoothed_range(const Control* self, float* lo, float* hi)
+{
+    const float a = self->offset + self->gain * KNOB_MIN;
+    const float b = self->offset + self->gain * KNOB_MAX;
+
+    *lo = a < b ? a : b;
+    *hi = a < b ? b : a;
+}
+
+/** Whether the CV input is connected and moves the output. */
+static bool
+modulated(const Control* self)
+{
+    return self->cv_input && *self->depth != 0.0f;
+}
+
+/**
+   Render the output from start up to end towards the current knob value.
+   The CV input, scaled by Depth in knob units per volt and mapped like the
+   knob, is added and clamped to the output range.  While the range glides
+   a chunk is clamped to what it covered from its start to its end, then the
+   output is
+   quantized and fed to the scope.  These stages take the output a chunk at
+   a time, while it is still in cache from the smoother writing it.
+*/
+static void
+render(Control* self, uint32_t start, uint32_t end)
+{
+    if (end <= start)
+        return;
+
+    const float level    = target_level(self);
+    const bool  modulate = modulated(self);
+
+    if (!modulate && !self->quantizer.active && !self->scope.interval) {
+        render_level(self, level, self->output + start, end - start);
+        return;
+    }
+
+    float chunk[RANGE_CHUNK];
+
+    for (uint32_t i = start; i < end;) {
+        const uint32_t n   = end - i < RANGE_CHUNK ? end - i : RANGE_CHUNK;
+        float*         out = self->output + i;
+
+        if (modulate) {
+            float lo, hi, end_lo, end_hi;
+
+            smoothed_range(self, &lo, &hi);
+            render_level(self, level, chunk, n);
+            smoothed_range(self, &end_lo, &end_hi);
+
+            modulation_render(out, chunk, self->cv_input + i, *self->depth * self->gain,
+                              lo < end_lo ? lo : end_lo, hi > end_hi ? hi : end_hi, n);
+        }
+        else {
+            render_level(self, level, out, n);
+        }
+
+        if (self->quantizer.active)
+            quantizer_render(&self->quantizer, out, n);
+        if (self->scope.interval)
+            scope_feed(&self->scope, out, n);
+
+        i += n;
+    }
+}
+
+static SmoothMode
+smooth_mode(const Control* self)
+{
+    const int mode = (int)*self->smooth;
+    return (mode > SMOOTH_OFF && mode < SMOOTH_MODE_COUNT) ? (SmoothMode)mode : SMOOTH_OFF;
+}
+
+/** Samples per control point of the smoother, 1 at audio rate. */
+static uint32_t
+control_rate_factor(const Control* self)
+{
+    const int factor = (int)*self->control_rate;
+    return (factor == 16 || factor == 32) ? (uint32_t)factor : 1;
+}
+
+/**
+   Whether a controller value is for the assigned controller.  While learning
+   the controller is assigned, stored in the state and reported to the UI.
+*/
+static bool
+midi_assigned(Control* self, const MidiControlValue* cv)
+{
+    State* state = &self->states[self->state_front];
+
+    if (self->midi_learn) {
+        const bool is_cc = cv->source == MIDI_SOURCE_CC;
+        state->midi_cc.body   = is_cc ? cv->number : MIDI_CONTROL_NONE;
+        state->midi_nrpn.body = is_cc ? MIDI_CONTROL_NONE : cv->number;
+
+        mark_dirty(self, state_map_find(&self->state_map, self->uris.midi_cc));
+        mark_dirty(self, state_map_find(&self->state_map, self->uris.midi_nrpn));
+
+        self->midi_learn = false;
+        return true;
+    }
+
+    return cv->number == (cv->source == MIDI_SOURCE_CC ? state->midi_cc.body
+                                                       : state->midi_nrpn.body);
+}
+
+/**
+   Send a Float event with the difference to the last value sent wherever the
+   output moved more than the threshold away from it.  A consumer adds the
+   deltas to the absolute value it got last as plug:output.
+
+   Deltas that do not fit in the output leave room for the notifications and
+   the scope, and are folded into the next one, so the sum stays right.
+*/
+static void
+send_value_events(Control* self, uint32_t start, uint32_t end)
+{
+    if (!self->events_on || self->event_sync)
+        return;
+
+    LV2_Atom_Forge* forge     = &self->forge;
+    const float*    out       = self->output;
+    const float     threshold = *self->event_threshold;
+    float           value     = self->event_value;
+
+    // the output mostly holds a constant, check the range before finding frames
+    float deviation = 0.0f;
+    for (uint32_t i = start; i < end; i++)
+        deviation = fmaxf(deviation, fabsf(out[i] - value));
+
+    if (!(deviation > threshold))
+        return;
+
+    for (uint32_t i = start; i < end; i++) {
+        if (!(fabsf(out[i] - value) > threshold))
+            continue;
+        if (forge->offset + VALUE_EVENT_SIZE + NOTIFY_BUDGET + SCOPE_BUDGET > forge->size)
+            break;
+
+        const float delta = out[i] - value;
+        lv2_atom_forge_frame_time(forge, i);
+        lv2_atom_forge_float(forge, delta);
+        value += delta;
+        self->events_sent++;
     }
+
+    self->event_value = value;
+    self->event_moved = true;
+}
+
+/**
+   Render the output up to a frame of the block and return it.  Events are
+   in frame order, so this is where the value events up to it are sent.
+*/
+static uint32_t
+render_to(Control* self, uint32_t offset, int64_t frames, uint32_t n_samples)
+{
+    uint32_t frame = offset;
+    if (frames > offset)
+        frame = frames < n_samples ? (uint32_t)frames : n_samples;
+
+    render(self, offset, frame);
+    send_value_events(self, offset, frame);
+
+    return frame;
+}
+
+/**
+   Send the absolute output value at the end of the block when a consumer
+   asked for it, or when the output settled after moving with value events.  The deltas add up
+   with rounding errors, this keeps them from drifting.
+*/
+static void
+send_output_value(Control* self, uint32_t n_samples)
+{
+    const bool settled = self->event_moved && self->events_sent == 0;
+
+    if (!n_samples || !(self->event_sync || (self->events_on && settled)))
+        return;
+
+    LV2_Atom_Float value = {
+        { sizeof(float), self->uris.atom_Float },
+        self->output[n_samples - 1]
+    };
+
+    if (!notify_fits(self, &value.atom))
+        return;
+
+    forge_set(self, n_samples - 1, self->uris.output, &value.atom);
+
+    self->event_value = value.body;
+    self->event_sync  = false;
+    self->event_moved = false;
+}
+
+/**
+   Send the scope points of this block as one Float vector of min, max and
+   last triples.  Without room in the output they wait for the next block.
+*/
+static void
+send_scope(Control* self, uint32_t n_samples)
+{
+    Scope* scope = &self->scope;
+
+    if (!n_samples || !scope->n_points)
+        return;
+
+    struct {
+        LV2_Atom_Vector vector;
+        ScopePoint      points[SCOPE_MAX_POINTS];
+    } value;
+
+    value.vector.atom.type       = self->uris.atom_Vector;
+    value.vector.atom.size       = (uint32_t)(sizeof(LV2_Atom_Vector_Body) + scope->n_points * sizeof(ScopePoint));
+    value.vector.body.child_size = sizeof(float);
+    value.vector.body.child_type = self->uris.atom_Float;
+    memcpy(value.points, scope->points, scope->n_points * sizeof(ScopePoint));
+
+    if (self->forge.offset + NOTIFY_OVERHEAD + lv2_atom_pad_size(value.vector.atom.size) > self->forge.size)
+        return;
+
+    forge_set(self, n_samples - 1, self->uris.scope, &value.vector.atom);
+    scope->n_points = 0;
+}
+
+/**
+   Apply a knob value at the frame of its event.
+   The block is rendered up to that frame first, so the new value, and the
+   smoothing towards it, starts exactly on the right sample.
+*/
+static uint32_t
+apply_knob_event(Control* self, uint32_t offset, int64_t frames, uint32_t n_samples, float value)
+{
+    const uint32_t frame = render_to(self, offset, frames, n_samples);
+
+    self->knob = value < KNOB_MIN ? KNOB_MIN : value > KNOB_MAX ? KNOB_MAX : value;
+
+    return frame;
 }
 
 static void
@@ -614,18 +1745,77 @@ run(LV2_Handle instance, uint32_t n_samples)
     URIs*    uris = &self->uris;
     LV2_Atom_Forge* forge = &self->forge;
 
+    // subnormals would only come from a filter tail, flush them while we run
+    const DenormalState fp_state = denormals_disable();
+
+    PERF_RUN_BEGIN(&self->perf);
+
     // Initially, self->out_port contains a Chunk with size set to capacity
     // Set up forge to write directly to output port
     const uint32_t out_capacity = self->out_port->atom.size;
     lv2_atom_forge_set_buffer(forge, (uint8_t*)self->out_port, out_capacity);
-    lv2_atom_forge_sequence_head(forge, &self->notify_frame, 0);
 
     // Start a sequence in the output port
     LV2_Atom_Forge_Frame out_frame;
     lv2_atom_forge_sequence_head(forge, &out_frame, 0);
 
+    // A restored state and a compiled curve apply from the start of the block
+    state_acquire(self);
+    curve_acquire(self);
+
+    // Property notifications of this block stay within budget and capacity
+    self->notify_limit = forge->offset + NOTIFY_BUDGET < out_capacity
+                       ? forge->offset + NOTIFY_BUDGET : out_capacity;
+
+    // Only recomputes coefficients if the mode or times changed
+    smoother_configure(&self->smoother, smooth_mode(self), *self->smooth_time, *self->fall_time);
+    smoother_set_decimation(&self->smoother, control_rate_factor(self),
+                            (int)*self->interpolation == INTERPOLATION_HOLD);
+    update_output_mapping(self);
+    update_quantizer(self);
+    scope_set_interval(&self->scope, *self->scope_interval > 0.0f ? (uint32_t)*self->scope_interval : 0);
+
+    // Value events start with the absolute value
+    const bool events_on = *self->value_events > 0.5f;
+    if (events_on && !self->events_on)
+        self->event_sync = true;
+    self->events_on   = events_on;
+    self->events_sent = 0;
+
+    // A moved Knob port applies from the start of the block
+    if (*self->level != self->prev_knob_port) {
+        self->prev_knob_port = *self->level;
+        self->knob = *self->level;
+    }
+
+    // Output rendered so far, events split the block at their frame
+    uint32_t offset = 0;
+
     // Read incoming events
     LV2_ATOM_SEQUENCE_FOREACH (self->in_port, ev) {
+        PERF_COUNT(&self->perf, events);
+
+        if (ev->body.type == uris->atom_Float) {
+            // Plain float, a new knob value
+            const float value = ((const LV2_Atom_Float*)&ev->body)->body;
+            offset = apply_knob_event(self, offset, ev->time.frames, n_samples, value);
+            continue;
+        }
+
+        if (ev->body.type == uris->midi_Event) {
+            // controller values move the knob at the frame of the event
+            MidiControlValue cv;
+            if (midi_control_read(&self->midi, (const uint8_t*)(ev + 1), ev->body.size, &cv) &&
+                midi_assigned(self, &cv)) {
+                const float value = KNOB_MIN + cv.value * (KNOB_MAX - KNOB_MIN);
+                offset = apply_knob_event(self, offset, ev->time.frames, n_samples, value);
+            }
+            continue;
+        }
+
+        if (!lv2_atom_forge_is_object_type(forge, ev->body.type))
+            continue;
+
         const LV2_Atom_Object* obj = (const LV2_Atom_Object*)&ev->body;
         if (obj->body.otype == uris->patch_Set) {
             // Get the property and value of the set message
@@ -650,6 +1840,24 @@ run(LV2_Handle instance, uint32_t n_samples)
             else if (property->atom.type != uris->atom_URID) {
                 lv2_log_error(&self->logger, "Set property is not a URID\n");
             }
+            else if (!value) {
+                lv2_log_error(&self->logger, "Set with no value\n");
+            }
+            else if (property->body == uris->knob) {
+                if (value->type == uris->atom_Float) {
+                    const float knob = ((const LV2_Atom_Float*)value)->body;
+                    offset = apply_knob_event(self, offset, ev->time.frames, n_samples, knob);
+                }
+                else {
+                    lv2_log_error(&self->logger, "Set knob value is not a Float\n");
+                }
+            }
+            else if (property->body == uris->midi_learn) {
+                if (value->type == uris->atom_Bool)
+                    self->midi_learn = ((const LV2_Atom_Bool*)value)->body != 0;
+                else
+                    lv2_log_error(&self->logger, "Set MIDI learn value is not a Bool\n");
+            }
             else {
                 // Set property to the given value
                 const LV2_URID key = property->body;
@@ -672,96 +1880,119 @@ run(LV2_Handle instance, uint32_t n_samples)
                 lv2_log_error(&self->logger, "Get with unknown subject\n");
             }
             else if (!property) {
-                // Get with no property, emit complete state
-                lv2_atom_forge_frame_time(forge, ev->time.frames);
-                LV2_Atom_Forge_Frame pframe;
-                lv2_atom_forge_object(forge, &pframe, 0, uris->patch_Put);
-                lv2_atom_forge_key(forge, uris->patch_body);
-
-                LV2_Atom_Forge_Frame bframe;
-                lv2_atom_forge_object(forge, &bframe, 0, 0);
-                save(self, write_param_to_forge, forge, 0, NULL);
-
-                lv2_atom_forge_pop(forge, &bframe);
-                lv2_atom_forge_pop(forge, &pframe);
+                // Get with no property, send the complete state within the output budget
+                for (unsigned i = 0; i < N_PROPS; ++i)
+                    mark_dirty(self, &self->props[i]);
+                self->event_sync = true;
             }
             else if (property->atom.type != uris->atom_URID) {
                 lv2_log_error(&self->logger, "Get property is not a URID\n");
             }
+            else if (property->body == uris->output) {
+                // the output value is sent at the end of the block
+                self->event_sync = true;
+            }
             else {
                 // Get for a specific property
                 const LV2_URID  key   = property->body;
                 const LV2_Atom* value = get_parameter(self, key);
                 if (value) {
-                    lv2_atom_forge_frame_time(forge, ev->time.frames);
-                    LV2_Atom_Forge_Frame frame;
-                    lv2_atom_forge_object(forge, &frame, 0, uris->patch_Set);
-                    lv2_atom_forge_key(forge, uris->patch_property);
-                    lv2_atom_forge_urid(forge, property->body);
-                    store_prop(self,
-                               NULL,
-                               NULL,
-                               write_param_to_forge,
-                               forge,
-                               uris->patch_value,
-                               value);
-                    lv2_atom_forge_pop(forge, &frame);
+                    StateMapItem* entry = state_map_find(&self->state_map, key);
+
+                    // value events before it come first in the sequence
+                    offset = render_to(self, offset, ev->time.frames, n_samples);
+
+                    if (notify_fits(self, value))
+                        forge_set(self, offset, key, value);
+                    else if (entry)
+                        mark_dirty(self, entry);
+#ifdef PERF_COUNTERS
+                    else if (key == uris->perf) {
+                        self->perf_dirty     = true;
+                        self->notify_pending = true;
+                    }
+#endif
                 }
             }
         }
     }
 
-    // notify of state change
+    // apply a state change
     if (self->state_changed) {
-        const uint32_t last_frame = n_samples-1;
-
-        // string 1
-        {
-            lv2_atom_forge_frame_time(forge, last_frame);
-            LV2_Atom_Forge_Frame frame;
-            lv2_atom_forge_object(forge, &frame, 0, uris->patch_Set);
-            lv2_atom_forge_key(forge, uris->patch_property);
-            lv2_atom_forge_urid(forge, uris->unit_string);
-            lv2_atom_forge_key(forge, uris->patch_value);
-            lv2_atom_forge_string(forge, self->state.unitstring_data, strlen(self->state.unitstring_data)+1);
-            lv2_atom_forge_pop(forge, &frame);
-        }
+        // pooled with the default filled in and the characters checked
+        const char* unit = unit_text(&self->states[self->state_front]);
 
-        char *unit = self->state.unitstring_data;
-        if (unit[0] == '\0')
-                strcpy(unit, UNIT_STRING_TEXT);
-
-        //sanity check for the chars we want to display
-        check_string(unit);
-
-        self->hmi->set_unit(self->hmi->handle, self->control_addressing, unit);
+        if (self->hmi && self->control_addressing) {
+            if (self->schedule)
+                post_hmi(self, HMI_UPDATE_UNIT);
+            else {
+                self->hmi->set_unit(self->hmi->handle, self->control_addressing, unit);
+                PERF_COUNT_HMI(&self->perf, hmi_set_unit);
+            }
+        }
 
         self->state_changed = false;
     }
 
-    float coef = *self->level;
-
-    for ( uint32_t i = 0; i < n_samples; i++)
-    {
-        float smooth = lowPassProcess(self, coef);
+    render_to(self, offset, n_samples, n_samples);
 
-        if ((int)*self->smooth == 1) {
-            coef = smooth;
-        }
+    // notify of changed properties after the value events of the block, the scope last
+    send_output_value(self, n_samples);
+    notify_dirty_props(self, n_samples ? n_samples - 1 : 0);
+    send_scope(self, n_samples);
 
-        self->output[i] = coef;
-    }
+    // the value table is only looked up again for a new range or addressing
+    bool range_changed = self->addressing_changed;
 
-    //update screen value
-    if ((*self->level != self->prev_value) ||
+    //update screen value, only if the displayed text changes
+    if ((self->knob != self->prev_value) ||
         (*self->min != self->prev_min) ||
         (*self->max != self->prev_max) ||
         (*self->round != self->prev_round))
     {
-        update_screen_value(self);
+        range_changed |= *self->min != self->prev_min || *self->max != self->prev_max ||
+                         *self->round != self->prev_round;
+
+        self->prev_value = self->knob;
+        self->prev_min = *self->min;
+        self->prev_max = *self->max;
+        self->prev_round = *self->round;
+
+        // a lookup once the worker has formatted the steps of this range
+        const HmiValueTable* table = screen_table(self);
+        const int64_t        key   = table ? table->screen_key[hmi_table_step(table, self->knob)]
+                                           : current_screen_key(self);
+
+        if (key == self->prev_key) {
+            PERF_COUNT(&self->perf, hmi_suppressed);
+        }
+        else if (self->hmi && self->control_addressing) {
+            self->prev_key = key;
+            PERF_COUNT_HMI(&self->perf, hmi_sent);
+
+            if (self->schedule)
+                post_hmi(self, HMI_UPDATE_VALUE);
+            else
+                update_screen_value(self);
+        }
     }
 
+    if (self->schedule) {
+        if (range_changed && self->hmi && self->control_addressing) {
+            self->addressing_changed = false;
+            request_screen_table(self);
+        }
+
+        post_hmi_updates(self);
+    }
+
+    request_curve(self);
+
     lv2_atom_forge_pop(forge, &out_frame);
+
+    PERF_RUN_END(&self->perf, n_samples, forge->offset);
+
+    denormals_restore(fp_state);
 }
 
 static void
@@ -772,9 +2003,109 @@ deactivate(LV2_Handle instance)
 static void
 cleanup(LV2_Handle instance)
 {
+    Control* self = (Control*) instance;
+
+    for (unsigned i = 0; i < 3; ++i)
+        unit_pool_release(self->states[i].unitstring);
+    unit_pool_release(atomic_load_explicit(&self->unit_shown, memory_order_relaxed));
+    unit_pool_release(self->unit_default);
+
+    free(atomic_load_explicit(&self->hmi_tables, memory_order_relaxed));
+    free(atomic_load_explicit(&self->curve_tables, memory_order_relaxed));
     free(instance);
 }
 
+/**
+   Worker side of the display updates and the curves.
+   Drains the ring and sends only the newest update of each type, the host
+   HMI callbacks and the value formatting happen here instead of in run().
+   Curves are compiled without a response, it would allow the next display
+   work before this one is done.
+*/
+static LV2_Worker_Status
+work(LV2_Handle                  instance,
+     LV2_Worker_Respond_Function respond,
+     LV2_Worker_Respond_Handle   handle,
+     uint32_t                    size,
+     const void*                 data)
+{
+    Control* self = (Control*) instance;
+
+    if (size == sizeof(CurveWork) && *(const uint32_t*)data == WORK_CURVE) {
+        const CurveWork* curve = (const CurveWork*)data;
+        return curve_publish(self, curve->points, curve->n_points) ? LV2_WORKER_SUCCESS
+                                                                   : LV2_WORKER_ERR_NO_SPACE;
+    }
+
+    HmiUpdate latest[HMI_UPDATE_COUNT];
+    bool      has_update[HMI_UPDATE_COUNT] = { false };
+    HmiUpdate update;
+
+    while (hmi_ring_pop(&self->hmi_ring, &update)) {
+        latest[update.type] = update;
+        has_update[update.type] = true;
+    }
+
+    const LV2_HMI_Addressing addressing = self->control_addressing;
+
+    if (self->hmi && addressing) {
+        if (has_update[HMI_UPDATE_UNIT]) {
+            self->hmi->set_unit(self->hmi->handle, addressing, latest[HMI_UPDATE_UNIT].data.unit);
+            PERF_COUNT_HMI(&self->perf, hmi_set_unit);
+        }
+
+        if (has_update[HMI_UPDATE_VALUE]) {
+            const char* text = latest[HMI_UPDATE_VALUE].data.value.text;
+            char        bfr[SCREEN_VALUE_SIZE];
+
+            if (!text) {
+                format_screen_value(bfr, sizeof(bfr),
+                                    latest[HMI_UPDATE_VALUE].data.value.level,
+                                    latest[HMI_UPDATE_VALUE].data.value.min,
+                                    latest[HMI_UPDATE_VALUE].data.value.max,
+                                    latest[HMI_UPDATE_VALUE].data.value.round);
+                text = bfr;
+            }
+
+            self->hmi->set_value(self->hmi->handle, addressing, text);
+            PERF_COUNT_HMI(&self->perf, hmi_set_value);
+        }
+    }
+
+    // A text run() posted points into the live table, or into the one built
+    // here if run() looked before the last swap.  That run() posted it before
+    // this work was scheduled, it has been sent above.
+    if (has_update[HMI_UPDATE_TABLE]) {
+        HmiValueTable* tables = atomic_load_explicit(&self->hmi_tables, memory_order_relaxed);
+        if (!tables) {
+            tables = (HmiValueTable*)calloc(2, sizeof(HmiValueTable));
+            atomic_store_explicit(&self->hmi_tables, tables, memory_order_release);
+        }
+
+        if (tables) {
+            const unsigned live = atomic_load_explicit(&self->hmi_table_live, memory_order_relaxed);
+
+            hmi_table_build(&tables[!live], &latest[HMI_UPDATE_TABLE].data.table);
+            atomic_store_explicit(&self->hmi_table_live, !live, memory_order_release);
+        }
+    }
+
+    const uint32_t token = WORK_HMI;
+    return respond(handle, sizeof(token), &token);
+}
+
+/** Called in the audio thread once display work is done, allows the next schedule. */
+static LV2_Worker_Status
+work_response(LV2_Handle instance, uint32_t size, const void* data)
+{
+    Control* self = (Control*) instance;
+
+    self->work_scheduled = false;
+    self->hmi_posting    = true;   // updates pushed while it ran wait in the ring
+
+    return LV2_WORKER_SUCCESS;
+}
+
 static void
 addressed(LV2_Handle handle, uint32_t index, LV2_HMI_Addressing addressing, const LV2_HMI_AddressingInfo* info)
 {
@@ -782,17 +2113,27 @@ addressed(LV2_Handle handle, uint32_t index, LV2_HMI_Addressing addressing, cons
 
     if (index == Knob) {
         self->control_addressing = addressing;
+        self->addressing_changed = true;
+
+        if (info) {
+            self->control_min   = info->min;
+            self->control_max   = info->max;
+            self->control_steps = info->steps;
+        }
 
         update_screen_value(self);
+        PERF_COUNT_HMI(&self->perf, hmi_sent);
 
-        char *unit = self->state.unitstring_data;
-        if (unit[0] == '\0')
-                strcpy(unit, UNIT_STRING_TEXT);
+        // run() may replace the unit meanwhile, it is copied with a reference held
+        const LV2_Atom* atom = acquire_shown_unit(self);
+        char            unit[HMI_UNIT_SIZE];
 
-        //sanity check for the chars we want to display
-        check_string(unit);
+        strncpy(unit, (const char*)(atom + 1), HMI_UNIT_SIZE - 1);
+        unit[HMI_UNIT_SIZE - 1] = '\0';
+        unit_pool_release(atom);
 
         self->hmi->set_unit(self->hmi->handle, self->control_addressing, unit);
+        PERF_COUNT_HMI(&self->perf, hmi_set_unit);
     }
 }
 
@@ -801,8 +2142,10 @@ unaddressed(LV2_Handle handle, uint32_t index)
 {
     Control* self = (Control*) handle;
 
-    if (index == Knob)
+    if (index == Knob) {
         self->control_addressing = NULL;
+        self->control_steps = 0;
+    }
 }
 
 static const void*
@@ -820,6 +2163,11 @@ extension_data(const char* uri)
         return &state;
     }
 
+    static const LV2_Worker_Interface worker = {work, work_response, NULL};
+    if (!strcmp(uri, LV2_WORKER__interface)) {
+        return &worker;
+    }
+
     return NULL;
 }
 
@@ -840,6 +2188,7 @@ lv2_descriptor(uint32_t index)
 {
     switch (index) {
         case 0:  return &descriptor;
+        case 1:  return &control_bank_descriptor;
         default: return NULL;
     }
 }
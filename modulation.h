@@ -0,0 +1,74 @@
+/*
+  CV modulation for mod-advanced-control-to-cv
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+  THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+   Offset and attenuverter stage of the CV input, the work of a separate
+   modulation plugin folded into the render of the output.
+*/
+
+#ifndef MODULATION_H_INCLUDED
+#define MODULATION_H_INCLUDED
+
+#include <stdint.h>
+
+#include "smoothing.h"
+
+/**
+   out = clamp(level + cv * scale, lo, hi), lo <= hi.
+   The CV input is only read, and every sample of it is read before the same
+   sample of out is written, so the host may connect it to the output buffer.
+*/
+static inline void
+modulation_render(float* out, const float* level, const float* cv,
+                  float scale, float lo, float hi, uint32_t n_samples)
+{
+    uint32_t i = 0;
+
+#if defined(__AVX__)
+    const __m256 vscale = _mm256_set1_ps(scale);
+    const __m256 vlo    = _mm256_set1_ps(lo);
+    const __m256 vhi    = _mm256_set1_ps(hi);
+
+    for (; i + 8 <= n_samples; i += 8) {
+        const __m256 sum = _mm256_add_ps(_mm256_loadu_ps(level + i),
+                                         _mm256_mul_ps(_mm256_loadu_ps(cv + i), vscale));
+        _mm256_storeu_ps(out + i, _mm256_min_ps(_mm256_max_ps(sum, vlo), vhi));
+    }
+#elif defined(__SSE2__)
+    const __m128 vscale = _mm_set1_ps(scale);
+    const __m128 vlo    = _mm_set1_ps(lo);
+    const __m128 vhi    = _mm_set1_ps(hi);
+
+    for (; i + 4 <= n_samples; i += 4) {
+        const __m128 sum = _mm_add_ps(_mm_loadu_ps(level + i), _mm_mul_ps(_mm_loadu_ps(cv + i), vscale));
+        _mm_storeu_ps(out + i, _mm_min_ps(_mm_max_ps(sum, vlo), vhi));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const float32x4_t vlo = vdupq_n_f32(lo);
+    const float32x4_t vhi = vdupq_n_f32(hi);
+
+    for (; i + 4 <= n_samples; i += 4) {
+        const float32x4_t sum = vmlaq_n_f32(vld1q_f32(level + i), vld1q_f32(cv + i), scale);
+        vst1q_f32(out + i, vminq_f32(vmaxq_f32(sum, vlo), vhi));
+    }
+#endif
+
+    for (; i < n_samples; i++) {
+        const float sum = level[i] + cv[i] * scale;
+        out[i] = sum < lo ? lo : sum > hi ? hi : sum;
+    }
+}
+
+#endif /* MODULATION_H_INCLUDED */
@@ -0,0 +1,196 @@
+/*
+  Number formatting for mod-advanced-control-to-cv
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+  THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+   Integer and fixed point formatting without stdio, for the HMI display.
+
+   Digits are produced two at a time from a lookup table and written straight
+   into their final position, the length is known before anything is written.
+   The output is identical to snprintf() with "%lld" and "%.*f", including
+   "nan", "inf", "-0.000" and round-half-even on exact ties.
+
+   All functions write at most size bytes including the terminating zero.  If
+   the text does not fit, or the value is outside the supported range, the
+   string is set to empty and 0 is returned.  Otherwise the length is returned.
+*/
+
+#ifndef NUM_FORMAT_H_INCLUDED
+#define NUM_FORMAT_H_INCLUDED
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/** Largest precision supported by format_fixed(). */
+#define NUM_FORMAT_MAX_PRECISION    9
+
+static const char num_format_pairs[200] = {
+    '0','0','0','1','0','2','0','3','0','4','0','5','0','6','0','7','0','8','0','9',
+    '1','0','1','1','1','2','1','3','1','4','1','5','1','6','1','7','1','8','1','9',
+    '2','0','2','1','2','2','2','3','2','4','2','5','2','6','2','7','2','8','2','9',
+    '3','0','3','1','3','2','3','3','3','4','3','5','3','6','3','7','3','8','3','9',
+    '4','0','4','1','4','2','4','3','4','4','4','5','4','6','4','7','4','8','4','9',
+    '5','0','5','1','5','2','5','3','5','4','5','5','5','6','5','7','5','8','5','9',
+    '6','0','6','1','6','2','6','3','6','4','6','5','6','6','6','7','6','8','6','9',
+    '7','0','7','1','7','2','7','3','7','4','7','5','7','6','7','7','7','8','7','9',
+    '8','0','8','1','8','2','8','3','8','4','8','5','8','6','8','7','8','8','8','9',
+    '9','0','9','1','9','2','9','3','9','4','9','5','9','6','9','7','9','8','9','9',
+};
+
+static const uint64_t num_format_pow10[NUM_FORMAT_MAX_PRECISION + 1] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL,
+    1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL,
+};
+
+/** Number of decimal digits of v, at least 1. */
+static inline uint32_t
+num_format_count_digits(uint64_t v)
+{
+    uint32_t n = 1;
+
+    for (;;) {
+        if (v < 10)    return n;
+        if (v < 100)   return n + 1;
+        if (v < 1000)  return n + 2;
+        if (v < 10000) return n + 3;
+        v /= 10000;
+        n += 4;
+    }
+}
+
+/** Write the n_digits lowest digits of v, zero padded, into str[0..n_digits). */
+static inline void
+num_format_digits(char* str, uint64_t v, uint32_t n_digits)
+{
+    char* pos = str + n_digits;
+
+    while (n_digits >= 2) {
+        const uint32_t pair = (uint32_t)(v % 100) * 2;
+        v /= 100;
+        pos -= 2;
+        pos[0] = num_format_pairs[pair];
+        pos[1] = num_format_pairs[pair + 1];
+        n_digits -= 2;
+    }
+
+    if (n_digits)
+        pos[-1] = (char)('0' + v % 10);
+}
+
+static inline uint32_t
+num_format_fail(char* str, uint32_t size)
+{
+    if (size)
+        *str = '\0';
+    return 0;
+}
+
+static inline uint32_t
+num_format_text(const char* text, uint32_t len, char* str, uint32_t size)
+{
+    if (len + 1 > size)
+        return num_format_fail(str, size);
+
+    memcpy(str, text, len + 1);
+    return len;
+}
+
+static uint32_t
+format_int(int64_t num, char* str, uint32_t size)
+{
+    if (!str)
+        return 0;
+
+    const bool     negative  = num < 0;
+    const uint64_t magnitude = negative ? 0 - (uint64_t)num : (uint64_t)num;
+    const uint32_t n_digits  = num_format_count_digits(magnitude);
+    const uint32_t len       = negative + n_digits;
+
+    if (len + 1 > size)
+        return num_format_fail(str, size);
+
+    if (negative)
+        str[0] = '-';
+
+    num_format_digits(str + negative, magnitude, n_digits);
+    str[len] = '\0';
+
+    return len;
+}
+
+/**
+   Format num with a fixed number of decimals, like "%.*f".
+   NaN and infinity are detected on the bit pattern since the plugin is built
+   with -ffast-math, which lets the compiler assume isnan() and isinf() are
+   always false.  Values of 2^64 / 10^precision and above are out of range.
+*/
+static uint32_t
+format_fixed(float num, uint8_t precision, char* str, uint32_t size)
+{
+    if (!str)
+        return 0;
+
+    if (precision > NUM_FORMAT_MAX_PRECISION)
+        return num_format_fail(str, size);
+
+    uint32_t bits;
+    memcpy(&bits, &num, sizeof(bits));
+
+    const bool     negative = bits >> 31;
+    const uint32_t exponent = (bits >> 23) & 0xff;
+
+    if (exponent == 0xff) {
+        if (bits & 0x7fffff)
+            return negative ? num_format_text("-nan", 4, str, size)
+                            : num_format_text("nan", 3, str, size);
+        return negative ? num_format_text("-inf", 4, str, size)
+                        : num_format_text("inf", 3, str, size);
+    }
+
+    // exact: a float has 24 significant bits and 5^9 needs 21 more
+    const double scaled = rint(fabs((double)num) * (double)num_format_pow10[precision]);
+
+    if (scaled >= 18446744073709551616.0)
+        return num_format_fail(str, size);
+
+    const uint64_t fixed    = (uint64_t)scaled;
+    const uint64_t intp     = fixed / num_format_pow10[precision];
+    const uint64_t fracp    = fixed % num_format_pow10[precision];
+    const uint32_t n_digits = num_format_count_digits(intp);
+    const uint32_t len      = negative + n_digits + (precision ? 1 + precision : 0);
+
+    if (len + 1 > size)
+        return num_format_fail(str, size);
+
+    char* pos = str;
+
+    if (negative)
+        *pos++ = '-';
+
+    num_format_digits(pos, intp, n_digits);
+    pos += n_digits;
+
+    if (precision) {
+        *pos++ = '.';
+        num_format_digits(pos, fracp, precision);
+    }
+
+    str[len] = '\0';
+
+    return len;
+}
+
+#endif /* NUM_FORMAT_H_INCLUDED */
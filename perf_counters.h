@@ -0,0 +1,125 @@
+/*
+  Performance counters for mod-advanced-control-to-cv
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+  THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+   Per-instance counters of what run() costs, compiled in with
+   `make PERF_COUNTERS=true`.
+
+   Without PERF_COUNTERS the PERF_ macros expand to nothing and the counters
+   are not part of the instance, so a normal build pays nothing for them.
+
+   Cycles are read from the time stamp counter on x86 and from the virtual
+   counter on aarch64, which ticks at a fixed rate below the CPU clock.  Other
+   targets count nanoseconds.
+*/
+
+#ifndef PERF_COUNTERS_H_INCLUDED
+#define PERF_COUNTERS_H_INCLUDED
+
+#ifdef PERF_COUNTERS
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#elif !defined(__aarch64__)
+#include <time.h>
+#endif
+
+/** Weight of the newest run() in the average, as a power of two. */
+#define PERF_EWMA_SHIFT     4
+
+typedef struct {
+    uint64_t run_calls;
+    uint64_t samples;
+    uint64_t cycles_min;
+    uint64_t cycles_max;
+    double   cycles_ewma;
+    uint64_t events;
+    uint64_t forge_bytes;
+
+    // display values skipped because the text did not change
+    uint64_t hmi_suppressed;
+
+    // also counted by the worker, or by addressed() for hmi_sent
+    atomic_uint_fast64_t hmi_set_value;
+    atomic_uint_fast64_t hmi_set_unit;
+    atomic_uint_fast64_t hmi_sent;
+} PerfCounters;
+
+static inline uint64_t
+perf_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static inline void
+perf_init(PerfCounters* perf)
+{
+    memset(perf, 0, sizeof(*perf));
+    perf->cycles_min = UINT64_MAX;
+    atomic_init(&perf->hmi_set_value, 0);
+    atomic_init(&perf->hmi_set_unit, 0);
+    atomic_init(&perf->hmi_sent, 0);
+}
+
+static inline void
+perf_run_end(PerfCounters* perf, uint64_t start, uint32_t n_samples, uint32_t forge_bytes)
+{
+    const uint64_t cycles = perf_cycles() - start;
+
+    if (cycles < perf->cycles_min)
+        perf->cycles_min = cycles;
+    if (cycles > perf->cycles_max)
+        perf->cycles_max = cycles;
+
+    if (perf->run_calls == 0)
+        perf->cycles_ewma = (double)cycles;
+    else
+        perf->cycles_ewma += ((double)cycles - perf->cycles_ewma) / (1 << PERF_EWMA_SHIFT);
+
+    perf->run_calls++;
+    perf->samples     += n_samples;
+    perf->forge_bytes += forge_bytes;
+}
+
+#define PERF_RUN_BEGIN(perf)                const uint64_t perf_start = perf_cycles()
+#define PERF_RUN_END(perf, n, forge_bytes)  perf_run_end((perf), perf_start, (n), (forge_bytes))
+#define PERF_COUNT(perf, field)             ((perf)->field++)
+#define PERF_COUNT_HMI(perf, field) \
+    atomic_fetch_add_explicit(&(perf)->field, 1, memory_order_relaxed)
+
+#else
+
+#define PERF_RUN_BEGIN(perf)
+#define PERF_RUN_END(perf, n, forge_bytes)  ((void)0)
+#define PERF_COUNT(perf, field)             ((void)0)
+#define PERF_COUNT_HMI(perf, field)         ((void)0)
+
+#endif /* PERF_COUNTERS */
+
+#endif /* PERF_COUNTERS_H_INCLUDED */
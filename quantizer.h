@@ -0,0 +1,202 @@
+/*
+  Output quantizer for mod-advanced-control-to-cv
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+  THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+   Quantizes the output to the notes of a scale at 1 V per octave, or to
+   equal steps.
+
+   The notes repeat every period, an octave of 1 V or one step.  A table
+   maps every cell of a period to the nearest note, which can lie in the
+   period below or above.  The cells are fine enough that the midpoints
+   between two semitones, where the nearest note changes, fall exactly on
+   cell edges, so the table gives the same notes as a search would.
+
+   Hysteresis keeps the output on its note until the input is a window past
+   the midpoint to the next one.  With lo and hi the notes of the input
+   moved down and up by the window, the output is the previous output
+   clamped to [lo, hi]: it stays while it lies in between, and moves to the
+   nearest note on the side the input went when it does not.
+*/
+
+#ifndef QUANTIZER_H_INCLUDED
+#define QUANTIZER_H_INCLUDED
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/** Cells of the table per period, 128 per semitone. */
+#define QUANTIZE_CELLS      1536
+
+/** Samples quantized per pass. */
+#define QUANTIZE_CHUNK      64
+
+#define QUANTIZE_SEMITONES  12
+
+/** The C major scale, the default scale mask. */
+#define QUANTIZE_MAJOR      0xAB5
+
+typedef enum {
+    QUANTIZE_OFF = 0,
+    QUANTIZE_CHROMATIC,
+    QUANTIZE_SCALE,
+    QUANTIZE_STEPS,
+    QUANTIZE_MODE_COUNT
+} QuantizeMode;
+
+typedef struct {
+    bool     active;
+    float    origin;
+    float    period;
+    float    inv_period;
+    float    window;
+
+    // notes the table is built for, bit k is note k of n_notes per period
+    uint32_t mask;
+    uint32_t n_notes;
+
+    // last output, primed with the first input
+    bool     primed;
+    float    value;
+
+    // nearest note of every cell, in periods from the start of the cell's period
+    float    table[QUANTIZE_CELLS];
+} Quantizer;
+
+static inline void
+quantizer_init(Quantizer* q)
+{
+    memset(q, 0, sizeof(*q));
+}
+
+/** Fill the table in one sweep over the cells and the sorted notes around the period. */
+static void
+quantizer_build(Quantizer* q, uint32_t mask, uint32_t n_notes)
+{
+    float    notes[3 * QUANTIZE_SEMITONES];
+    uint32_t count = 0;
+
+    for (int wrap = -1; wrap <= 1; wrap++) {
+        for (uint32_t k = 0; k < n_notes; k++) {
+            if (mask & (1u << k))
+                notes[count++] = (float)wrap + (float)k / (float)n_notes;
+        }
+    }
+
+    uint32_t nearest = 0;
+    for (uint32_t c = 0; c < QUANTIZE_CELLS; c++) {
+        const float center = ((float)c + 0.5f) / (float)QUANTIZE_CELLS;
+
+        while (nearest + 1 < count &&
+               fabsf(notes[nearest + 1] - center) <= fabsf(notes[nearest] - center))
+            nearest++;
+
+        q->table[c] = notes[nearest];
+    }
+
+    q->mask    = mask;
+    q->n_notes = n_notes;
+}
+
+/**
+   Set the mode and the grid.  Notes start at origin and repeat every period,
+   a scale mask only matters in scale mode, the hysteresis is a fraction of
+   the distance between two semitones or steps.  The table is only built
+   again when the notes change.
+*/
+static inline void
+quantizer_configure(Quantizer* q, QuantizeMode mode, uint32_t scale_mask,
+                    float origin, float period, float hysteresis)
+{
+    uint32_t mask    = scale_mask & ((1u << QUANTIZE_SEMITONES) - 1);
+    uint32_t n_notes = QUANTIZE_SEMITONES;
+
+    if (mode == QUANTIZE_CHROMATIC)
+        mask = (1u << QUANTIZE_SEMITONES) - 1;
+    else if (mode == QUANTIZE_STEPS) {
+        mask    = 1;
+        n_notes = 1;
+    }
+
+    const bool active = mode > QUANTIZE_OFF && mode < QUANTIZE_MODE_COUNT && mask && period > 0.0f;
+
+    if (!active || !q->active)
+        q->primed = false;
+
+    q->active = active;
+    if (!active)
+        return;
+
+    if (mask != q->mask || n_notes != q->n_notes)
+        quantizer_build(q, mask, n_notes);
+
+    q->origin     = origin;
+    q->period     = period;
+    q->inv_period = 1.0f / period;
+    q->window     = hysteresis * period / (float)n_notes;
+}
+
+/** The nearest note, no branches. */
+static inline float
+quantize(const Quantizer* q, float x)
+{
+    const float t      = (x - q->origin) * q->inv_period;
+    const float octave = floorf(t);
+    const int   cell   = (int)((t - octave) * (float)QUANTIZE_CELLS);
+    const int   index  = cell < QUANTIZE_CELLS - 1 ? cell : QUANTIZE_CELLS - 1;
+
+    return q->origin + (octave + q->table[index]) * q->period;
+}
+
+/**
+   Quantize n_samples of out in place.  The notes around every sample are
+   found in a loop without dependencies between samples, only the clamp of
+   the hysteresis runs from sample to sample.
+*/
+static inline void
+quantizer_render(Quantizer* q, float* out, uint32_t n_samples)
+{
+    float lo[QUANTIZE_CHUNK];
+    float hi[QUANTIZE_CHUNK];
+
+    if (n_samples && !q->primed) {
+        q->value  = quantize(q, out[0]);
+        q->primed = true;
+    }
+
+    float value = q->value;
+
+    while (n_samples) {
+        const uint32_t n = n_samples < QUANTIZE_CHUNK ? n_samples : QUANTIZE_CHUNK;
+
+        for (uint32_t i = 0; i < n; i++) {
+            lo[i] = quantize(q, out[i] - q->window);
+            hi[i] = quantize(q, out[i] + q->window);
+        }
+
+        for (uint32_t i = 0; i < n; i++) {
+            value  = fminf(fmaxf(value, lo[i]), hi[i]);
+            out[i] = value;
+        }
+
+        out       += n;
+        n_samples -= n;
+    }
+
+    q->value = value;
+}
+
+#endif /* QUANTIZER_H_INCLUDED */
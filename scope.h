@@ -0,0 +1,107 @@
+/*
+  Output telemetry for mod-advanced-control-to-cv
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+  THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+   Decimated envelope of the output for meters and scopes in the UI.
+
+   Every interval samples of output give one point, the minimum, maximum
+   and last value over them.  Points wait in a short queue until the block
+   sends them.  When more points come in than the queue holds, the newest
+   ones are merged into the last point, so the envelope gets coarser but
+   never misses a peak, and the message stays within a fixed size.
+*/
+
+#ifndef SCOPE_H_INCLUDED
+#define SCOPE_H_INCLUDED
+
+#include <math.h>
+#include <stdint.h>
+
+/** Points sent per block at most. */
+#define SCOPE_MAX_POINTS    16
+
+typedef struct {
+    float min;
+    float max;
+    float last;
+} ScopePoint;
+
+typedef struct {
+    uint32_t   interval;   // samples per point, 0 is off
+    uint32_t   count;      // samples in the open point
+    ScopePoint open;
+    uint32_t   n_points;
+    ScopePoint points[SCOPE_MAX_POINTS];
+} Scope;
+
+/** Start over with a new interval, only when it changed. */
+static inline void
+scope_set_interval(Scope* scope, uint32_t interval)
+{
+    if (interval == scope->interval)
+        return;
+
+    scope->interval = interval;
+    scope->count    = 0;
+    scope->n_points = 0;
+}
+
+static inline void
+scope_merge(ScopePoint* into, const ScopePoint* point)
+{
+    into->min  = fminf(into->min, point->min);
+    into->max  = fmaxf(into->max, point->max);
+    into->last = point->last;
+}
+
+/** Add n_samples of output, which should still be in cache. */
+static inline void
+scope_feed(Scope* scope, const float* in, uint32_t n_samples)
+{
+    while (n_samples) {
+        const uint32_t left = scope->interval - scope->count;
+        const uint32_t n    = n_samples < left ? n_samples : left;
+
+        // a reduction without branches, vectorized
+        float lo = in[0];
+        float hi = in[0];
+        for (uint32_t i = 1; i < n; i++) {
+            lo = fminf(lo, in[i]);
+            hi = fmaxf(hi, in[i]);
+        }
+
+        const ScopePoint part = { lo, hi, in[n - 1] };
+        if (scope->count)
+            scope_merge(&scope->open, &part);
+        else
+            scope->open = part;
+
+        scope->count += n;
+        in           += n;
+        n_samples    -= n;
+
+        if (scope->count < scope->interval)
+            continue;
+
+        if (scope->n_points < SCOPE_MAX_POINTS)
+            scope->points[scope->n_points++] = scope->open;
+        else
+            scope_merge(&scope->points[SCOPE_MAX_POINTS - 1], &scope->open);
+
+        scope->count = 0;
+    }
+}
+
+#endif /* SCOPE_H_INCLUDED */
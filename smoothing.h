@@ -0,0 +1,697 @@
+/*
+  Smoothing engines for mod-advanced-control-to-cv
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+  THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#ifndef SMOOTHING_H_INCLUDED
+#define SMOOTHING_H_INCLUDED
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SMOOTH_VECTOR_SIZE 8
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SMOOTH_VECTOR_SIZE 4
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SMOOTH_VECTOR_SIZE 4
+#else
+#define SMOOTH_VECTOR_SIZE 4
+#endif
+
+/**
+   The glide Smoothing always had.  The old filter fed its output back as its
+   input, so it moved once per block by 1 - exp(-2 pi 550 Hz / rate), a time
+   constant of about 14 blocks, 37 ms at 128 samples and 48 kHz.
+*/
+#define SMOOTH_TIME_DEFAULT 37.0f
+
+/**
+   Distance to the target below which a filter is considered settled and
+   snapped onto it, far below what a float output near the target resolves.
+*/
+#define SMOOTH_SETTLED      1e-6
+
+/**
+   One-pole low-pass filter, z1 = x * a0 + z1 * b1.
+
+   While the input holds a constant target the recurrence has the closed form
+   z1[n] = target + (z1[0] - target) * b1^n, which lets a whole block be
+   rendered without a serial dependency between samples.  The distance to the
+   target is kept in double precision and only advanced once per vector, each
+   lane then scales it by its own entry of the b1 power table.
+
+   The rendered output matches the per-sample recurrence (evaluated in double
+   and stored as float) to within 4 ulp of max(|target|, |z1|), that is about
+   4e-6 V over the 0..10 V range of the CV output.
+
+   It replaced a filter stepped once per block, see SMOOTH_TIME_DEFAULT.  At
+   128 samples and 48 kHz kernel_bench measures both within 2.5e-3 V of each
+   other at the end of every block, knob levels jumping at random over
+   0..10 V.  Within a block they differ by up to the step the old filter took
+   at its start, 6.9 % of the distance to the target, 0.62 V there.  At
+   other block sizes the old glide was faster or slower, this one is not.
+*/
+typedef struct {
+    double a0;
+    double b1;
+    double z1;
+
+    // b1^1 .. b1^SMOOTH_VECTOR_SIZE, for the lanes of one vector
+    double pow[SMOOTH_VECTOR_SIZE];
+    float  powf[SMOOTH_VECTOR_SIZE] __attribute__((aligned(32)));
+} OnePole;
+
+/** Set the time constant, in samples.  The filter state is kept. */
+static void
+one_pole_set_time(OnePole* lp, double samples)
+{
+    lp->b1 = samples > 0.0 ? exp(-1.0 / samples) : 0.0;
+    lp->a0 = 1.0 - lp->b1;
+
+    double p = 1.0;
+    for (int i = 0; i < SMOOTH_VECTOR_SIZE; i++) {
+        p *= lp->b1;
+        lp->pow[i]  = p;
+        lp->powf[i] = (float)p;
+    }
+}
+
+/** Write target + d * b1^k for k = 1 .. SMOOTH_VECTOR_SIZE to out. */
+static inline void
+one_pole_store(const OnePole* lp, float target, float d, float* out)
+{
+#if defined(__AVX__)
+    const __m256 vp = _mm256_load_ps(lp->powf);
+    _mm256_storeu_ps(out, _mm256_add_ps(_mm256_set1_ps(target), _mm256_mul_ps(_mm256_set1_ps(d), vp)));
+#elif defined(__SSE2__)
+    const __m128 vp = _mm_load_ps(lp->powf);
+    _mm_storeu_ps(out, _mm_add_ps(_mm_set1_ps(target), _mm_mul_ps(_mm_set1_ps(d), vp)));
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    vst1q_f32(out, vmlaq_n_f32(vdupq_n_f32(target), vld1q_f32(lp->powf), d));
+#else
+    out[0] = target + d * lp->powf[0];
+    out[1] = target + d * lp->powf[1];
+    out[2] = target + d * lp->powf[2];
+    out[3] = target + d * lp->powf[3];
+#endif
+}
+
+/** Constant output, what a settled filter renders. */
+static inline void
+fill_render(float value, float* out, uint32_t n_samples)
+{
+    for (uint32_t i = 0; i < n_samples; i++)
+        out[i] = value;
+}
+
+/**
+   Render n_samples of the filter response towards a constant target, mapped
+   to gain * z1 + offset.  The mapping is folded into the target and the
+   distance, it costs nothing per sample.  Once settled the filter sits
+   exactly on the target and the block is a constant fill.
+*/
+static inline void
+one_pole_render(OnePole* lp, float target, float gain, float offset, float* out, uint32_t n_samples)
+{
+    const float mapped = target * gain + offset;
+    double      d      = lp->z1 - target;
+    uint32_t    i      = 0;
+
+    if (d == 0.0) {
+        fill_render(mapped, out, n_samples);
+        return;
+    }
+
+    for (; i + SMOOTH_VECTOR_SIZE <= n_samples; i += SMOOTH_VECTOR_SIZE) {
+        one_pole_store(lp, mapped, (float)(d * gain), out + i);
+        d *= lp->pow[SMOOTH_VECTOR_SIZE - 1];
+    }
+
+    const uint32_t rest = n_samples - i;
+    if (rest) {
+        const float df = (float)(d * gain);
+        for (uint32_t k = 0; k < rest; k++)
+            out[i + k] = mapped + df * lp->powf[k];
+        d *= lp->pow[rest - 1];
+    }
+
+    lp->z1 = fabs(d) < SMOOTH_SETTLED ? target : target + d;
+}
+
+/**
+   One-pole response of several channels that share the coefficients.
+
+   The state is kept as structure of arrays, the distance of every channel to
+   its target in dist.  All channels are rendered in a single pass over the
+   block, one vector of samples per channel at a time, and the distances of
+   all channels are advanced together once per vector.  Settled channels are
+   snapped to their target, a bank where all channels are settled is filled.
+*/
+static inline void
+one_pole_bank_render(const OnePole* lp, const float* target, double* dist,
+                     float* const* out, uint32_t n_channels, uint32_t n_samples)
+{
+    uint32_t i = 0;
+    bool     settled = true;
+
+    for (uint32_t c = 0; c < n_channels; c++)
+        settled = settled && dist[c] == 0.0;
+
+    if (settled) {
+        for (uint32_t c = 0; c < n_channels; c++)
+            fill_render(target[c], out[c], n_samples);
+        return;
+    }
+
+    for (; i + SMOOTH_VECTOR_SIZE <= n_samples; i += SMOOTH_VECTOR_SIZE) {
+        for (uint32_t c = 0; c < n_channels; c++)
+            one_pole_store(lp, target[c], (float)dist[c], out[c] + i);
+
+        for (uint32_t c = 0; c < n_channels; c++)
+            dist[c] *= lp->pow[SMOOTH_VECTOR_SIZE - 1];
+    }
+
+    const uint32_t rest = n_samples - i;
+    if (rest) {
+        for (uint32_t c = 0; c < n_channels; c++) {
+            const float df = (float)dist[c];
+            for (uint32_t k = 0; k < rest; k++)
+                out[c][i + k] = target[c] + df * lp->powf[k];
+            dist[c] *= lp->pow[rest - 1];
+        }
+    }
+
+    for (uint32_t c = 0; c < n_channels; c++) {
+        if (fabs(dist[c]) < SMOOTH_SETTLED)
+            dist[c] = 0.0;
+    }
+}
+
+/**
+   Two one-pole stages in series with the same coefficient, the critically
+   damped response.  With e1 and e2 the distances of both stages to a constant
+   target, the second stage follows z2[n] = target + b1^n * (e2 + n * a0 * e1),
+   so the lanes of a vector are again independent.  Mapped like
+   one_pole_render().
+*/
+static inline void
+two_pole_render(OnePole* lp, double* z2, float target, float gain, float offset, float* out, uint32_t n_samples)
+{
+    const float mapped = target * gain + offset;
+    double      e1     = lp->z1 - target;
+    double      e2     = *z2 - target;
+    uint32_t    i      = 0;
+
+    if (e1 == 0.0 && e2 == 0.0) {
+        fill_render(mapped, out, n_samples);
+        return;
+    }
+
+    for (; i + SMOOTH_VECTOR_SIZE <= n_samples; i += SMOOTH_VECTOR_SIZE) {
+        const float fe1 = (float)(e1 * lp->a0 * gain);
+        const float fe2 = (float)(e2 * gain);
+        for (uint32_t k = 0; k < SMOOTH_VECTOR_SIZE; k++)
+            out[i + k] = mapped + lp->powf[k] * (fe2 + (float)(k + 1) * fe1);
+
+        e2  = lp->pow[SMOOTH_VECTOR_SIZE - 1] * (e2 + SMOOTH_VECTOR_SIZE * lp->a0 * e1);
+        e1 *= lp->pow[SMOOTH_VECTOR_SIZE - 1];
+    }
+
+    const uint32_t rest = n_samples - i;
+    if (rest) {
+        const float fe1 = (float)(e1 * lp->a0 * gain);
+        const float fe2 = (float)(e2 * gain);
+        for (uint32_t k = 0; k < rest; k++)
+            out[i + k] = mapped + lp->powf[k] * (fe2 + (float)(k + 1) * fe1);
+
+        e2  = lp->pow[rest - 1] * (e2 + rest * lp->a0 * e1);
+        e1 *= lp->pow[rest - 1];
+    }
+
+    if (fabs(e1) < SMOOTH_SETTLED && fabs(e2) < SMOOTH_SETTLED)
+        e1 = e2 = 0.0;
+
+    lp->z1 = target + e1;
+    *z2    = target + e2;
+}
+
+/**
+   Straight line from start with the given step for the first n_ramp samples,
+   the target for the rest of the block.
+*/
+static inline void
+ramp_render(float start, float step, uint32_t n_ramp, float target, float* out, uint32_t n_samples)
+{
+    for (uint32_t i = 0; i < n_ramp; i++)
+        out[i] = start + step * (float)(i + 1);
+
+    for (uint32_t i = n_ramp; i < n_samples; i++)
+        out[i] = target;
+}
+
+typedef enum {
+    SMOOTH_OFF = 0,
+    SMOOTH_ONE_POLE,
+    SMOOTH_TWO_POLE,
+    SMOOTH_LINEAR,
+    SMOOTH_SLEW,
+    SMOOTH_MODE_COUNT
+} SmoothMode;
+
+/**
+   Selectable smoothing of a stepped control value.
+
+   The time parameter is the time constant of the one-pole, the time constant
+   of each stage of the two-pole is half of it.  For the linear ramp it is the
+   duration of every transition, regardless of its size.  The slew limiter
+   uses it as the rise time and a separate fall time, both for a change over
+   the full scale.
+
+   Coefficients are only recomputed by smoother_configure() when a parameter
+   changes.  Rendering picks a kernel specialised for the mode and for a
+   mapped output or not from a table once per call, the per-sample work of
+   every kernel is branch free.
+
+   Optionally the smoother runs at control rate, see smoother_set_decimation().
+*/
+typedef struct {
+    SmoothMode mode;
+    double     rate;
+    float      full_scale;
+    float      time_ms;
+    float      fall_ms;
+
+    // last output, the starting point when the mode changes
+    float      value;
+
+    OnePole    one_pole;
+    OnePole    two_pole;
+    double     two_pole_z2;
+
+    float      ramp_target;
+    float      ramp_step;
+    uint32_t   ramp_left;
+    uint32_t   ramp_samples;
+
+    float      rise_step;
+    float      fall_step;
+
+    // control rate rendering, value is then the next control point
+    uint32_t   decimation;
+    float      tick_scale;
+    bool       hold;
+    double     one_pole_tick;
+    double     two_pole_tick;
+    float      tick_value;
+    float      tick_step;
+    uint32_t   tick_left;
+} Smoother;
+
+static void
+smoother_set_coefficients(Smoother* s)
+{
+    const double rise = s->time_ms * 0.001 * s->rate;
+    const double fall = s->fall_ms * 0.001 * s->rate;
+
+    one_pole_set_time(&s->one_pole, rise);
+    one_pole_set_time(&s->two_pole, rise * 0.5);
+
+    s->ramp_samples = rise > 1.0 ? (uint32_t)lrint(rise) : 1;
+    s->rise_step    = s->full_scale / (float)(rise > 1.0 ? rise : 1.0);
+    s->fall_step    = s->full_scale / (float)(fall > 1.0 ? fall : 1.0);
+
+    // b1^decimation, a whole control period of each filter at once
+    s->tick_scale    = 1.0f / (float)s->decimation;
+    s->one_pole_tick = pow(s->one_pole.b1, (double)s->decimation);
+    s->two_pole_tick = pow(s->two_pole.b1, (double)s->decimation);
+}
+
+/** Restart every mode from the current output. */
+static inline void
+smoother_continue(Smoother* s)
+{
+    const float value = s->decimation > 1 ? s->tick_value : s->value;
+
+    s->value       = value;
+    s->one_pole.z1 = value;
+    s->two_pole.z1 = value;
+    s->two_pole_z2 = value;
+    s->ramp_target = value;
+    s->ramp_left   = 0;
+    s->tick_value  = value;
+    s->tick_left   = 0;
+}
+
+static inline void
+smoother_init(Smoother* s, double rate, float full_scale, SmoothMode mode, float time_ms, float fall_ms)
+{
+    s->mode        = mode;
+    s->rate        = rate;
+    s->full_scale  = full_scale;
+    s->time_ms     = time_ms;
+    s->fall_ms     = fall_ms;
+    s->value       = 0.0f;
+
+    s->one_pole.z1 = 0.0;
+    s->two_pole.z1 = 0.0;
+    s->two_pole_z2 = 0.0;
+    s->ramp_target = 0.0f;
+    s->ramp_left   = 0;
+
+    s->decimation  = 1;
+    s->hold        = false;
+    s->tick_value  = 0.0f;
+    s->tick_left   = 0;
+
+    smoother_set_coefficients(s);
+}
+
+/** Update mode and times, cheap when nothing changed. */
+static inline void
+smoother_configure(Smoother* s, SmoothMode mode, float time_ms, float fall_ms)
+{
+    if (time_ms != s->time_ms || fall_ms != s->fall_ms) {
+        s->time_ms = time_ms;
+        s->fall_ms = fall_ms;
+        smoother_set_coefficients(s);
+    }
+
+    if (mode != s->mode) {
+        // continue from where the previous mode left the output
+        s->mode = mode;
+        smoother_continue(s);
+    }
+}
+
+/**
+   Run the smoother once every factor samples instead of every sample, a
+   factor of 1 renders at audio rate.  In between control points the output
+   is a straight line from one to the next, or with hold the next one held.
+
+   Every control point is the exact audio rate response, the smoother is
+   advanced over a whole period in closed form.  What is lost is the shape
+   within a period and up to factor - 1 samples of latency, a new target is
+   only picked up at the next control point.  Linear interpolation misses
+   the curvature within a period, for the one-pole at most about
+   (factor / time)^2 / 8 of a step with the time in samples: 5e-4 of a step
+   at 32 samples and 10 ms, and most of a step at 0.29 ms.  Hold is
+   off by up to the change over a whole period.  bench/smoothing_bench.c
+   measures both against the cost.
+*/
+static inline void
+smoother_set_decimation(Smoother* s, uint32_t factor, bool hold)
+{
+    if (factor < 1)
+        factor = 1;
+
+    if (factor == s->decimation && hold == s->hold)
+        return;
+
+    smoother_continue(s);
+    s->decimation = factor;
+    s->hold       = hold;
+    smoother_set_coefficients(s);
+}
+
+/**
+   Move the smoother n samples towards target without rendering them.
+   The filters advance by their tick powers, n has to be s->decimation.
+*/
+static inline void
+smoother_advance(Smoother* s, float target, uint32_t n)
+{
+    switch (s->mode) {
+        case SMOOTH_ONE_POLE: {
+            OnePole* lp = &s->one_pole;
+            double   d  = (lp->z1 - target) * s->one_pole_tick;
+            lp->z1   = fabs(d) < SMOOTH_SETTLED ? target : target + d;
+            s->value = (float)lp->z1;
+            break;
+        }
+
+        case SMOOTH_TWO_POLE: {
+            OnePole* lp = &s->two_pole;
+            double   e1 = lp->z1 - target;
+            double   e2 = s->two_pole_z2 - target;
+
+            e2  = s->two_pole_tick * (e2 + n * lp->a0 * e1);
+            e1 *= s->two_pole_tick;
+            if (fabs(e1) < SMOOTH_SETTLED && fabs(e2) < SMOOTH_SETTLED)
+                e1 = e2 = 0.0;
+
+            lp->z1         = target + e1;
+            s->two_pole_z2 = target + e2;
+            s->value       = (float)s->two_pole_z2;
+            break;
+        }
+
+        case SMOOTH_LINEAR: {
+            if (target != s->ramp_target) {
+                s->ramp_target = target;
+                s->ramp_left   = s->ramp_samples;
+                s->ramp_step   = (target - s->value) / (float)s->ramp_samples;
+            }
+
+            const uint32_t k = s->ramp_left < n ? s->ramp_left : n;
+            s->value      = k == s->ramp_left ? target : s->value + s->ramp_step * (float)k;
+            s->ramp_left -= k;
+            break;
+        }
+
+        case SMOOTH_SLEW: {
+            const float d    = target - s->value;
+            const float step = d > 0.0f ? s->rise_step : -s->fall_step;
+            s->value = d / step >= (float)n ? s->value + step * (float)n : target;
+            break;
+        }
+
+        case SMOOTH_OFF:
+        default:
+            s->value = target;
+            break;
+    }
+}
+
+/** One period or part of it, a constant trip count for whole periods lets the compiler vectorize. */
+static inline void
+tick_render(float start, float step, float* out, uint32_t n)
+{
+    if (step == 0.0f) {
+        if (n == 16)
+            fill_render(start, out, 16);
+        else if (n == 32)
+            fill_render(start, out, 32);
+        else
+            fill_render(start, out, n);
+    }
+    else {
+        if (n == 16)
+            ramp_render(start, step, 16, 0.0f, out, 16);
+        else if (n == 32)
+            ramp_render(start, step, 32, 0.0f, out, 32);
+        else
+            ramp_render(start, step, n, 0.0f, out, n);
+    }
+}
+
+/** Advance to the next control point and start the period leading to it. */
+static inline void
+smoother_tick(Smoother* s, float target)
+{
+    // at a control point the output sits on the smoother value
+    // without smoothing the output steps to the target, held like with hold
+    const float from = s->value;
+    const bool  step = s->hold || s->mode == SMOOTH_OFF;
+    smoother_advance(s, target, s->decimation);
+
+    s->tick_left  = s->decimation;
+    s->tick_step  = step ? 0.0f : (s->value - from) * s->tick_scale;
+    s->tick_value = step ? s->value : from;
+}
+
+/**
+   Render at control rate, mapped like smoother_render().  The one-pole and
+   two-pole tick powers are for a period of s->decimation samples, the only
+   length smoother_advance() is called with here.
+*/
+static inline void
+smoother_render_ticks(Smoother* s, float target, float gain, float offset, float* out, uint32_t n_samples)
+{
+    const uint32_t period = s->decimation;
+
+    // rest of the period from the previous block
+    if (s->tick_left) {
+        const uint32_t n = s->tick_left < n_samples ? s->tick_left : n_samples;
+        tick_render(s->tick_value * gain + offset, s->tick_step * gain, out, n);
+
+        // the end of a period is the control point itself
+        s->tick_left -= n;
+        s->tick_value = s->tick_left ? s->tick_value + s->tick_step * (float)n : s->value;
+        out       += n;
+        n_samples -= n;
+
+        // a block split at an event ends within the period, the next part goes on with it
+        if (!n_samples)
+            return;
+    }
+
+    for (; n_samples >= period; n_samples -= period, out += period) {
+        smoother_tick(s, target);
+        tick_render(s->tick_value * gain + offset, s->tick_step * gain, out, period);
+    }
+
+    // whole periods end on their control point
+    s->tick_left  = 0;
+    s->tick_value = s->value;
+
+    // start of the period the next block finishes
+    if (n_samples) {
+        smoother_tick(s, target);
+        tick_render(s->tick_value * gain + offset, s->tick_step * gain, out, n_samples);
+
+        s->tick_left -= n_samples;
+        s->tick_value += s->tick_step * (float)n_samples;
+    }
+}
+
+/**
+   Renders n_samples of one mode towards target, written as
+   gain * value + offset.
+*/
+typedef void (*SmoothKernel)(Smoother* s, float target, float gain, float offset, float* out, uint32_t n_samples);
+
+/**
+   Define the kernels of a mode from its body, one for a mapped output and one
+   for the smoothed value itself.  In the latter gain and offset are the
+   constants 1 and 0, the body is inlined into both and the mapping compiles
+   away.
+*/
+#define SMOOTH_KERNELS(name)                                                                  \
+    static void name##_mapped(Smoother* s, float target, float gain, float offset,           \
+                              float* out, uint32_t n_samples)                                 \
+    {                                                                                         \
+        name(s, target, gain, offset, out, n_samples);                                        \
+    }                                                                                         \
+    static void name##_unity(Smoother* s, float target, float gain, float offset,            \
+                             float* out, uint32_t n_samples)                                  \
+    {                                                                                         \
+        name(s, target, 1.0f, 0.0f, out, n_samples);                                          \
+    }
+
+static inline __attribute__((always_inline)) void
+smooth_off(Smoother* s, float target, float gain, float offset, float* out, uint32_t n_samples)
+{
+    fill_render(target * gain + offset, out, n_samples);
+    s->value = target;
+}
+
+static inline __attribute__((always_inline)) void
+smooth_one_pole(Smoother* s, float target, float gain, float offset, float* out, uint32_t n_samples)
+{
+    one_pole_render(&s->one_pole, target, gain, offset, out, n_samples);
+    s->value = (float)s->one_pole.z1;
+}
+
+static inline __attribute__((always_inline)) void
+smooth_two_pole(Smoother* s, float target, float gain, float offset, float* out, uint32_t n_samples)
+{
+    two_pole_render(&s->two_pole, &s->two_pole_z2, target, gain, offset, out, n_samples);
+    s->value = (float)s->two_pole_z2;
+}
+
+static inline __attribute__((always_inline)) void
+smooth_linear(Smoother* s, float target, float gain, float offset, float* out, uint32_t n_samples)
+{
+    if (target != s->ramp_target) {
+        s->ramp_target = target;
+        s->ramp_left   = s->ramp_samples;
+        s->ramp_step   = (target - s->value) / (float)s->ramp_samples;
+    }
+
+    // the last sample of a ramp is the exact target
+    const uint32_t n    = s->ramp_left < n_samples ? s->ramp_left : n_samples;
+    const bool     done = n == s->ramp_left;
+
+    ramp_render(s->value * gain + offset, s->ramp_step * gain,
+                done ? n - (n > 0) : n, target * gain + offset, out, n_samples);
+
+    s->value      = done ? target : s->value + s->ramp_step * (float)n;
+    s->ramp_left -= n;
+}
+
+static inline __attribute__((always_inline)) void
+smooth_slew(Smoother* s, float target, float gain, float offset, float* out, uint32_t n_samples)
+{
+    const float mapped = target * gain + offset;
+    const float d      = target - s->value;
+    const float step   = d > 0.0f ? s->rise_step : -s->fall_step;
+    const float need   = d / step;
+
+    if (need >= (float)n_samples) {
+        ramp_render(s->value * gain + offset, step * gain, n_samples, mapped, out, n_samples);
+        s->value += step * (float)n_samples;
+    }
+    else {
+        // reaches the target within this block
+        const uint32_t n = (uint32_t)ceilf(need);
+        ramp_render(s->value * gain + offset, step * gain, n - (n > 0), mapped, out, n_samples);
+        s->value = target;
+    }
+}
+
+SMOOTH_KERNELS(smooth_off)
+SMOOTH_KERNELS(smooth_one_pole)
+SMOOTH_KERNELS(smooth_two_pole)
+SMOOTH_KERNELS(smooth_linear)
+SMOOTH_KERNELS(smooth_slew)
+SMOOTH_KERNELS(smoother_render_ticks)
+
+/** Kernels by mode, the last row renders at control rate, columns are unity and mapped. */
+static const SmoothKernel smooth_kernels[SMOOTH_MODE_COUNT + 1][2] = {
+    { smooth_off_unity,            smooth_off_mapped },
+    { smooth_one_pole_unity,       smooth_one_pole_mapped },
+    { smooth_two_pole_unity,       smooth_two_pole_mapped },
+    { smooth_linear_unity,         smooth_linear_mapped },
+    { smooth_slew_unity,           smooth_slew_mapped },
+    { smoother_render_ticks_unity, smoother_render_ticks_mapped },
+};
+
+/** Kernel of the current mode and decimation, for a mapped output or not. */
+static inline SmoothKernel
+smoother_kernel(const Smoother* s, bool mapped)
+{
+    const uint32_t row = s->decimation > 1 ? SMOOTH_MODE_COUNT
+                       : (uint32_t)s->mode < SMOOTH_MODE_COUNT ? (uint32_t)s->mode : SMOOTH_OFF;
+    return smooth_kernels[row][mapped];
+}
+
+/**
+   Render n_samples towards target, written as gain * value + offset.
+   With a gain of 1 and an offset of 0 the output is the smoothed value itself.
+   The kernel is picked once per call, none of them branches per sample.
+*/
+static inline void
+smoother_render(Smoother* s, float target, float gain, float offset, float* out, uint32_t n_samples)
+{
+    if (n_samples == 0)
+        return;
+
+    smoother_kernel(s, gain != 1.0f || offset != 0.0f)(s, target, gain, offset, out, n_samples);
+}
+
+#endif /* SMOOTHING_H_INCLUDED */
@@ -17,59 +17,146 @@
 #include "lv2/urid/urid.h"
 
 #include <stdarg.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
-/** Entry in an array that serves as a dictionary of properties. */
+/** Most properties a state map can hold, may be defined before inclusion. */
+#ifndef STATE_MAP_MAX_ITEMS
+#  define STATE_MAP_MAX_ITEMS 32
+#endif
+
+/** Hash slots, at least four per property so probe chains stay short. */
+#define STATE_MAP_SLOTS (4 * STATE_MAP_MAX_ITEMS)
+
+/**
+   Entry in an array that serves as a dictionary of properties.
+   The type and the maximum body size come from the state map initialisation
+   and are what a new value is checked against.  The dirty flag marks a value
+   that still has to be sent to the host.
+*/
 typedef struct {
   const char* uri;
   LV2_URID    urid;
+  LV2_URID    type;
+  uint32_t    max_size;
   LV2_Atom*   value;
+  bool        dirty;
 } StateMapItem;
 
-/** Comparator for StateMapItems sorted by URID. */
-static int
-state_map_cmp(const void* a, const void* b)
+/**
+   Index of a state map by URID.
+   An open addressing hash table with a multiplicative hash, the multiplier is
+   chosen at initialisation for the shortest longest probe, usually none.  A
+   lookup therefore inspects at most max_probe + 1 slots.
+*/
+typedef struct {
+  StateMapItem* items;
+  uint32_t      n_items;
+  uint32_t      multiplier;
+  uint32_t      shift;
+  uint32_t      mask;
+  uint32_t      max_probe;
+  uint16_t      slots[STATE_MAP_SLOTS]; // item index + 1, 0 if empty
+} StateMap;
+
+static inline uint32_t
+state_map_slot(const StateMap* index, LV2_URID urid)
+{
+  return (uint32_t)(urid * index->multiplier) >> index->shift;
+}
+
+/** Fill the slots with the given multiplier, returns the longest probe. */
+static uint32_t
+state_map_build(StateMap* index, uint32_t multiplier)
+{
+  index->multiplier = multiplier;
+  memset(index->slots, 0, sizeof(index->slots));
+
+  uint32_t max_probe = 0;
+  for (uint32_t i = 0; i < index->n_items; ++i) {
+    uint32_t probe = 0;
+    uint32_t slot  = state_map_slot(index, index->items[i].urid);
+    while (index->slots[slot]) {
+      slot = (slot + 1) & index->mask;
+      ++probe;
+    }
+
+    index->slots[slot] = (uint16_t)(i + 1);
+    if (probe > max_probe) {
+      max_probe = probe;
+    }
+  }
+
+  return max_probe;
+}
+
+/** Build the index of n_items items, they are not moved. */
+static void
+state_map_index(StateMap* index, StateMapItem items[], uint32_t n_items)
 {
-  const StateMapItem* ka = (const StateMapItem*)a;
-  const StateMapItem* kb = (const StateMapItem*)b;
-  if (ka->urid < kb->urid) {
-    return -1;
+  uint32_t bits = 2;
+  while ((1u << bits) < 4 * n_items && (1u << bits) < STATE_MAP_SLOTS) {
+    ++bits;
   }
 
-  if (kb->urid < ka->urid) {
-    return 1;
+  index->items   = items;
+  index->n_items = n_items;
+  index->shift   = 32 - bits;
+  index->mask    = (1u << bits) - 1;
+
+  // Try a few odd multipliers, starting with the golden ratio one
+  uint32_t best       = 0;
+  uint32_t best_probe = UINT32_MAX;
+  uint32_t multiplier = 0x9E3779B1u;
+  for (int attempt = 0; attempt < 64 && best_probe > 0; ++attempt) {
+    const uint32_t probe = state_map_build(index, multiplier);
+    if (probe < best_probe) {
+      best       = multiplier;
+      best_probe = probe;
+    }
+
+    multiplier = (multiplier * 1664525u + 1013904223u) | 1u;
   }
 
-  return 0;
+  index->max_probe = best_probe;
+  state_map_build(index, best);
 }
 
-/** Helper macro for terse state map initialisation. */
+/**
+   Helper macro for terse state map initialisation.  The size and the value
+   are cast to the types state_map_init() reads them as.
+*/
 #define STATE_MAP_INIT(type, ptr) \
-  (LV2_ATOM__##type), (sizeof(*(ptr)) - sizeof(LV2_Atom)), (ptr)
+  (LV2_ATOM__##type), (uint32_t)(sizeof(*(ptr)) - sizeof(LV2_Atom)), (LV2_Atom*)(ptr)
 
 /**
    Initialise a state map.
    The variable parameters list must be NULL terminated, and is a sequence of
    const char* uri, const char* type, uint32_t size, LV2_Atom* value.  The
    value must point to a valid atom that resides elsewhere, the state map is
-   only an index and does not contain actual state values.  The macro
-   STATE_MAP_INIT can be used to make simpler code when state is composed of
-   standard atom types, for example:
+   only an index and does not contain actual state values.  The size is the
+   largest body the value can hold.  The macro STATE_MAP_INIT can be used to
+   make simpler code when state is composed of standard atom types, for
+   example:
    struct Plugin {
        LV2_URID_Map* map;
        StateMapItem  props[3];
+       StateMap      state_map;
        // ...
    };
    state_map_init(
-       self->props, self->map, self->map->handle,
+       &self->state_map, self->props, self->map, self->map->handle,
        PLUG_URI "#gain",   STATE_MAP_INIT(Float,  &state->gain),
        PLUG_URI "#offset", STATE_MAP_INIT(Int,    &state->offset),
        PLUG_URI "#file",   STATE_MAP_INIT(Path,   &state->file),
        NULL);
+   At most STATE_MAP_MAX_ITEMS properties are indexed.
 */
-static void
+static inline void
 state_map_init(
+  StateMap*           index,
   StateMapItem        dict[],
   LV2_URID_Map*       map,
   LV2_URID_Map_Handle handle,
@@ -79,32 +166,46 @@ state_map_init(
   unsigned i = 0;
   va_list  args;
   va_start(args, handle);
-  for (const char* uri = NULL; (uri = va_arg(args, const char*)); ++i) {
+  for (const char* uri = NULL;
+       i < STATE_MAP_MAX_ITEMS && (uri = va_arg(args, const char*));
+       ++i) {
     const char*     type  = va_arg(args, const char*);
     const uint32_t  size  = va_arg(args, uint32_t);
     LV2_Atom* const value = va_arg(args, LV2_Atom*);
     dict[i].uri           = uri;
     dict[i].urid          = map->map(map->handle, uri);
+    dict[i].type          = map->map(map->handle, type);
+    dict[i].max_size      = size;
     dict[i].value         = value;
     dict[i].value->size   = size;
-    dict[i].value->type   = map->map(map->handle, type);
+    dict[i].value->type   = dict[i].type;
+    dict[i].dirty         = false;
   }
   va_end(args);
 
-  // Sort for fast lookup by URID by state_map_find()
-  qsort(dict, i, sizeof(StateMapItem), state_map_cmp);
+  state_map_index(index, dict, i);
 }
 
 /**
    Retrieve an item from a state map by URID.
-   This takes O(lg(n)) time, and is useful for implementing generic property
+   This takes constant time, and is useful for implementing generic property
    access with little code, for example to respond to patch:Get messages for a
    specific property.
 */
-static StateMapItem*
-state_map_find(StateMapItem dict[], uint32_t n_entries, LV2_URID urid)
+static inline StateMapItem*
+state_map_find(const StateMap* index, LV2_URID urid)
 {
-  const StateMapItem key = {NULL, urid, NULL};
-  return (StateMapItem*)bsearch(
-    &key, dict, n_entries, sizeof(StateMapItem), state_map_cmp);
-}
\ No newline at end of file
+  const uint32_t slot = state_map_slot(index, urid);
+  for (uint32_t probe = 0; probe <= index->max_probe; ++probe) {
+    const uint16_t i = index->slots[(slot + probe) & index->mask];
+    if (!i) {
+      return NULL;
+    }
+
+    if (index->items[i - 1].urid == urid) {
+      return &index->items[i - 1];
+    }
+  }
+
+  return NULL;
+}
@@ -0,0 +1,185 @@
+/*
+  Interned unit strings for mod-advanced-control-to-cv
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+  THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/**
+   A pool of unit strings shared by every instance in the process.
+
+   Almost every instance shows the same few units, so the state holds a
+   reference to a string atom in the pool instead of a buffer of its own.
+   A string does not change while it is referenced.
+
+   The pool is a fixed arena, so interning never allocates or locks and can
+   run in the audio thread.  Entries are counted references: a string
+   nobody refers to any more is dead, and its entry is reused for a later
+   string that fits in it, so the pool only has to hold the strings in use.
+   Space for new entries is claimed with compare and swap, a claim that
+   does not fit takes nothing.  New entries are pushed on a list with
+   compare and swap and are never unlinked.  Two threads adding the same
+   string at once may both add it, that only costs space.
+*/
+
+#ifndef UNIT_POOL_H_INCLUDED
+#define UNIT_POOL_H_INCLUDED
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lv2/atom/atom.h"
+
+/** Bytes of strings the process can hold, untouched pages cost nothing. */
+#define UNIT_POOL_SIZE      (64 * 1024)
+
+// references of an entry being rewritten for a new string
+#define UNIT_POOL_WRITING   (-1)
+
+typedef struct UnitPoolEntry {
+    const struct UnitPoolEntry* next;
+    atomic_int                  refs;      // 0 when dead, UNIT_POOL_WRITING while reused
+    uint32_t                    capacity;  // bytes of string the entry holds
+    LV2_Atom                    atom;      // the string follows as the body
+} UnitPoolEntry;
+
+static struct {
+    uint8_t                 arena[UNIT_POOL_SIZE] __attribute__((aligned(__alignof__(UnitPoolEntry))));
+    atomic_size_t           used;
+    _Atomic(UnitPoolEntry*) head;
+} unit_pool;
+
+static inline UnitPoolEntry*
+unit_pool_entry(const LV2_Atom* atom)
+{
+    return (UnitPoolEntry*)((uint8_t*)atom - offsetof(UnitPoolEntry, atom));
+}
+
+/** Take another reference to a pooled string the caller holds one of. */
+static inline const LV2_Atom*
+unit_pool_retain(const LV2_Atom* atom)
+{
+    atomic_fetch_add_explicit(&unit_pool_entry(atom)->refs, 1, memory_order_relaxed);
+    return atom;
+}
+
+/**
+   Take a reference to a pooled string a reference of another thread may be
+   the last one to.  False if it is dead or being reused, once true it holds
+   whatever string the entry has now.
+*/
+static inline bool
+unit_pool_try_retain(const LV2_Atom* atom)
+{
+    UnitPoolEntry* entry = unit_pool_entry(atom);
+    int            refs  = atomic_load_explicit(&entry->refs, memory_order_relaxed);
+
+    while (refs > 0) {
+        if (atomic_compare_exchange_weak_explicit(&entry->refs, &refs, refs + 1,
+                                                  memory_order_acquire, memory_order_relaxed))
+            return true;
+    }
+
+    return false;
+}
+
+/** Give up a reference, NULL is ignored.  Realtime safe, nothing is freed. */
+static inline void
+unit_pool_release(const LV2_Atom* atom)
+{
+    if (atom)
+        atomic_fetch_sub_explicit(&unit_pool_entry(atom)->refs, 1, memory_order_release);
+}
+
+/**
+   A reference to the pooled string of type, NULL if it is not in the pool.
+   An entry is only read with a reference taken, so it cannot be reused
+   meanwhile.
+*/
+static inline const LV2_Atom*
+unit_pool_find(LV2_URID type, const char* text, uint32_t size)
+{
+    UnitPoolEntry* entry = atomic_load_explicit(&unit_pool.head, memory_order_acquire);
+
+    for (; entry; entry = (UnitPoolEntry*)entry->next) {
+        if (!unit_pool_try_retain(&entry->atom))
+            continue;
+
+        if (entry->atom.type == type && entry->atom.size == size && !memcmp(entry + 1, text, size))
+            return &entry->atom;
+
+        unit_pool_release(&entry->atom);
+    }
+
+    return NULL;
+}
+
+static inline const LV2_Atom*
+unit_pool_write(UnitPoolEntry* entry, LV2_URID type, const char* text, uint32_t size)
+{
+    entry->atom.type = type;
+    entry->atom.size = size;
+    memcpy(entry + 1, text, size);
+    atomic_store_explicit(&entry->refs, 1, memory_order_release);
+
+    return &entry->atom;
+}
+
+/**
+   A reference to the pooled string of type, added if it is not there yet.
+   The size includes the terminating zero.  Returns NULL when the strings in
+   use fill the pool.
+*/
+static inline const LV2_Atom*
+unit_pool_intern(LV2_URID type, const char* text, uint32_t size)
+{
+    const LV2_Atom* atom = unit_pool_find(type, text, size);
+    if (atom)
+        return atom;
+
+    // a dead entry large enough
+    UnitPoolEntry* entry = atomic_load_explicit(&unit_pool.head, memory_order_acquire);
+    for (; entry; entry = (UnitPoolEntry*)entry->next) {
+        int dead = 0;
+        if (entry->capacity >= size &&
+            atomic_compare_exchange_strong_explicit(&entry->refs, &dead, UNIT_POOL_WRITING,
+                                                    memory_order_acquire, memory_order_relaxed))
+            return unit_pool_write(entry, type, text, size);
+    }
+
+    // or a new one, claimed only if it fits
+    const size_t align = __alignof__(UnitPoolEntry);
+    const size_t bytes = (sizeof(UnitPoolEntry) + size + align - 1) & ~(align - 1);
+    size_t       start = atomic_load_explicit(&unit_pool.used, memory_order_relaxed);
+
+    do {
+        if (start + bytes > UNIT_POOL_SIZE)
+            return NULL;
+    } while (!atomic_compare_exchange_weak_explicit(&unit_pool.used, &start, start + bytes,
+                                                    memory_order_relaxed, memory_order_relaxed));
+
+    entry = (UnitPoolEntry*)(unit_pool.arena + start);
+    entry->capacity = (uint32_t)(bytes - sizeof(UnitPoolEntry));
+    unit_pool_write(entry, type, text, size);
+
+    UnitPoolEntry* head = atomic_load_explicit(&unit_pool.head, memory_order_relaxed);
+    do {
+        entry->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&unit_pool.head, &head, entry,
+                                                    memory_order_release, memory_order_relaxed));
+
+    return &entry->atom;
+}
+
+#endif /* UNIT_POOL_H_INCLUDED */